@@ -1,25 +1,123 @@
 #include "is-gauss.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <omp.h>
 
-int num_points(double r)
+std::uint64_t isqrt(std::uint64_t n)
 {
+    // Floating-point guess, then fix the last bit or two exactly;
+    // s stays below 2^32 so s * s cannot overflow
+    std::uint64_t s = static_cast<std::uint64_t>(std::sqrt(static_cast<double>(n)));
+    s = std::min<std::uint64_t>(s, 0xFFFFFFFFULL);
+    while (s * s > n)
+        --s;
+    while (s < 0xFFFFFFFFULL && (s + 1) * (s + 1) <= n)
+        ++s;
+    return s;
+}
 
-    long long count = 0;
-    // Loop through area
-    for (long x = 0; x <= r; x++)
+count_t num_points(std::uint64_t r)
+{
+    const std::uint64_t r2 = r * r;
+    const int num_threads = omp_get_max_threads();
+    std::vector<count_t> partial(num_threads, 0);
+
+    // One integer sqrt per row: row x holds 2 * isqrt(r^2 - x^2) + 1 points
+#pragma omp parallel
+    {
+        count_t sum = 0;
+#pragma omp for schedule(static)
+        for (std::uint64_t x = 1; x <= r; x++)
+        {
+            sum += isqrt(r2 - x * x);
+        }
+        partial[omp_get_thread_num()] = sum;
+    }
+
+    // Combine in thread order so the result never depends on timing
+    count_t quadrant = 0;
+    for (count_t p : partial)
+        quadrant += p;
+
+    // Axes plus four open quadrants
+    return 4 * static_cast<count_t>(r) + 1 + 4 * quadrant;
+}
+
+std::vector<count_t> num_points_batch(const std::vector<std::uint64_t> &radii)
+{
+    const std::size_t k = radii.size();
+    if (k == 0)
+        return {};
+
+    // Sweep radii in ascending order
+    std::vector<std::size_t> order(k);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&](std::size_t a, std::size_t b)
+              { return radii[a] < radii[b]; });
+    std::vector<std::uint64_t> r(k), r2(k);
+    for (std::size_t i = 0; i < k; i++)
     {
-        for (long y = 0; y <= r; y++)
+        r[i] = radii[order[i]];
+        r2[i] = r[i] * r[i];
+    }
+    const std::uint64_t r_max = r[k - 1];
+
+    const int num_threads = omp_get_max_threads();
+    std::vector<count_t> partial(num_threads * k, 0);
+
+#pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        const std::uint64_t x_begin = 1 + r_max * t / nt;
+        const std::uint64_t x_end = 1 + r_max * (t + 1) / nt;
+        count_t *sum = &partial[t * k];
+
+        // Each circle's boundary row y_i(x) only ever moves down as x grows,
+        // so after one sqrt per block it is tracked with a few compares.
+        std::size_t lo = std::lower_bound(r.begin(), r.end(), x_begin) - r.begin();
+        std::vector<std::uint64_t> y(k, 0);
+        for (std::size_t i = lo; i < k; i++)
+            y[i] = isqrt(r2[i] - x_begin * x_begin);
+
+        for (std::uint64_t x = x_begin; x < x_end; x++)
         {
-            if (x * x + y * y <= r * r)
+            while (lo < k && r[lo] < x)
+                ++lo;
+            const std::uint64_t x2 = x * x;
+            for (std::size_t i = lo; i < k; i++)
             {
-                ++count;
+                const std::uint64_t rem = r2[i] - x2;
+                while (y[i] * y[i] > rem)
+                    --y[i];
+                sum[i] += y[i];
             }
         }
     }
-    // Multiplying by four for each quadrant
-    count = 4 * count;
 
-    // Adjust for points on the axes
-    count -= ((4 * r) + 3);
+    std::vector<count_t> counts(k);
+    for (std::size_t i = 0; i < k; i++)
+    {
+        count_t quadrant = 0;
+        for (int t = 0; t < num_threads; t++)
+            quadrant += partial[t * k + i];
+        counts[order[i]] = 4 * static_cast<count_t>(r[i]) + 1 + 4 * quadrant;
+    }
+    return counts;
+}
 
-    return count;
-}
\ No newline at end of file
+std::string to_string(count_t n)
+{
+    if (n == 0)
+        return "0";
+    std::string digits;
+    while (n > 0)
+    {
+        digits.push_back(static_cast<char>('0' + static_cast<int>(n % 10)));
+        n /= 10;
+    }
+    std::reverse(digits.begin(), digits.end());
+    return digits;
+}
@@ -1,3 +1,21 @@
 #pragma once
 
-int num_points(double r);
\ No newline at end of file
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Lattice-point counts reach pi * r^2, which overflows 64 bits for r > ~3e9.
+using count_t = unsigned __int128;
+
+// Largest radius whose square still fits in 64 bits.
+const std::uint64_t max_radius = 4294967295ULL;
+
+std::uint64_t isqrt(std::uint64_t n);
+
+// Number of integer points (x, y) with x^2 + y^2 <= r^2.
+count_t num_points(std::uint64_t r);
+
+// Counts for many radii in one sweep over the rows; results are in input order.
+std::vector<count_t> num_points_batch(const std::vector<std::uint64_t> &radii);
+
+std::string to_string(count_t n);
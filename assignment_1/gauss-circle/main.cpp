@@ -1,13 +1,44 @@
 #include <iostream>
 #include <cstdlib>
+#include <cerrno>
+#include <chrono>
+#include <vector>
 #include "is-gauss.h"
 
 int main(int argc, char **argv)
 {
-    // Parse the radius from the command-line argument
-    double r = std::atoi(argv[1]);
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <radius> [<radius> ...]\n";
+        return 1;
+    }
 
-    long long count = num_points(r);
+    // Parse the radii as exact integers; several radii run in batch mode
+    std::vector<std::uint64_t> radii;
+    for (int i = 1; i < argc; i++)
+    {
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long r = std::strtoull(argv[i], &end, 10);
+        if (errno != 0 || *end != '\0' || argv[i][0] == '-' || r > max_radius)
+        {
+            std::cerr << "Invalid radius: " << argv[i]
+                      << " (expected an integer in [0, " << max_radius << "])\n";
+            return 1;
+        }
+        radii.push_back(r);
+    }
 
-    std::cout << "Number of points for radius " << r << " -> " << count << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<count_t> counts;
+    if (radii.size() == 1)
+        counts.push_back(num_points(radii[0]));
+    else
+        counts = num_points_batch(radii);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+
+    for (std::size_t i = 0; i < radii.size(); i++)
+        std::cout << "Number of points for radius " << radii[i] << " -> " << to_string(counts[i]) << std::endl;
+    std::cerr << "Counted in " << elapsed.count() << " ms." << std::endl;
 }
@@ -1,11 +1,96 @@
 #include "only-is-prime.h"
 
-bool is_prime(int n)
+using u64 = std::uint64_t;
+using u128 = unsigned __int128;
+
+// Arithmetic modulo an odd n in Montgomery form (R = 2^64), so the
+// exponentiation needs multiplies and shifts but no 128-bit divisions
+struct Montgomery
+{
+   u64 n, n_inv, r2;
+
+   explicit Montgomery(u64 modulus) : n(modulus)
+   {
+      // n^-1 mod 2^64 by Newton iteration (each step doubles the good bits)
+      n_inv = n;
+      for (int i = 0; i < 5; i++)
+         n_inv *= 2 - n * n_inv;
+      u64 r1 = (0 - n) % n; // 2^64 mod n
+      r2 = static_cast<u64>(static_cast<u128>(r1) * r1 % n);
+   }
+
+   // t * R^-1 mod n; the low words of t and m * n cancel, which avoids the
+   // overflow of the textbook (t + m * n) / R for n >= 2^63
+   u64 reduce(u128 t) const
+   {
+      u64 m = static_cast<u64>(t) * n_inv;
+      u64 hi = static_cast<u64>(t >> 64);
+      u64 mn = static_cast<u64>((static_cast<u128>(m) * n) >> 64);
+      return hi >= mn ? hi - mn : hi - mn + n;
+   }
+
+   u64 mul(u64 a, u64 b) const { return reduce(static_cast<u128>(a) * b); }
+   u64 to_mont(u64 a) const { return mul(a % n, r2); }
+};
+
+bool is_prime(std::uint64_t n)
 {
    if (n < 2)
       return false;
-   for (int i = 2; n >= i * i; i++)
-      if ((n % i) == 0)
+   static const u64 small_primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+   for (u64 p : small_primes)
+   {
+      if (n % p == 0)
+         return n == p;
+   }
+   if (n < 41 * 41)
+      return true;
+
+   // n - 1 = d * 2^s with d odd
+   u64 d = n - 1;
+   int s = 0;
+   while ((d & 1) == 0)
+   {
+      d >>= 1;
+      s++;
+   }
+
+   const Montgomery mont(n);
+   const u64 one = mont.to_mont(1);
+   const u64 minus_one = mont.to_mont(n - 1);
+
+   // These seven bases are known to decide primality for all n < 2^64
+   static const u64 bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+   for (u64 a : bases)
+   {
+      a %= n;
+      if (a == 0)
+         continue;
+
+      // x = a^d mod n
+      u64 x = one;
+      u64 base = mont.to_mont(a);
+      for (u64 e = d; e > 0; e >>= 1)
+      {
+         if (e & 1)
+            x = mont.mul(x, base);
+         base = mont.mul(base, base);
+      }
+      if (x == one || x == minus_one)
+         continue;
+
+      bool witness = true;
+      for (int r = 1; r < s; r++)
+      {
+         x = mont.mul(x, x);
+         if (x == minus_one)
+         {
+            witness = false;
+            break;
+         }
+      }
+      if (witness)
          return false;
+   }
    return true;
 }
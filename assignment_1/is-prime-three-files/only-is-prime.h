@@ -1,3 +1,6 @@
 #pragma once
 
-bool is_prime(int n);
+#include <cstdint>
+
+// Deterministic for every 64-bit n (Miller-Rabin, Montgomery arithmetic).
+bool is_prime(std::uint64_t n);
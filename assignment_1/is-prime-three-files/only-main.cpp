@@ -1,11 +1,105 @@
 #include <iostream>
+#include <fstream>
 #include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
 #include "only-is-prime.h"
+#include "prime-batch.h"
+
+static bool parse_u64(const char *text, std::uint64_t &value)
+{
+   char *end = nullptr;
+   errno = 0;
+   unsigned long long v = std::strtoull(text, &end, 10);
+   if (errno != 0 || end == text || *end != '\0' || text[0] == '-')
+      return false;
+   value = v;
+   return true;
+}
+
+static void read_numbers(std::istream &in, std::vector<std::uint64_t> &numbers)
+{
+   std::string token;
+   while (in >> token)
+   {
+      std::uint64_t v;
+      if (parse_u64(token.c_str(), v))
+         numbers.push_back(v);
+      else
+         std::cerr << "Skipping invalid number: " << token << "\n";
+   }
+}
+
+static int usage(const char *name)
+{
+   std::cerr << "Usage: " << name << " <n>\n"
+             << "       " << name << " --batch [<file> ...]   (reads stdin without files)\n"
+             << "       " << name << " --count <lo> <hi>\n"
+             << "       " << name << " --list <lo> <hi>\n";
+   return 1;
+}
 
 int main(int argc, char **argv)
 {
+   std::ios::sync_with_stdio(false);
+   if (argc < 2)
+      return usage(argv[0]);
+
+   if (std::strcmp(argv[1], "--batch") == 0)
+   {
+      std::vector<std::uint64_t> numbers;
+      if (argc == 2)
+         read_numbers(std::cin, numbers);
+      for (int i = 2; i < argc; i++)
+      {
+         std::ifstream file(argv[i]);
+         if (!file.is_open())
+         {
+            std::cerr << "Could not open file: " << argv[i] << "\n";
+            return 1;
+         }
+         read_numbers(file, numbers);
+      }
+
+      // One line per number: "<n> 1" if prime, "<n> 0" otherwise
+      const std::vector<char> prime = is_prime_batch(numbers);
+      std::string out;
+      for (std::size_t i = 0; i < numbers.size(); i++)
+      {
+         out += std::to_string(numbers[i]);
+         out += prime[i] ? " 1\n" : " 0\n";
+      }
+      std::cout << out;
+      return 0;
+   }
+
+   if (std::strcmp(argv[1], "--count") == 0 || std::strcmp(argv[1], "--list") == 0)
+   {
+      std::uint64_t lo, hi;
+      if (argc != 4 || !parse_u64(argv[2], lo) || !parse_u64(argv[3], hi))
+         return usage(argv[0]);
+      if (argv[1][2] == 'c')
+      {
+         std::cout << count_primes(lo, hi) << " primes in [" << lo << ", " << hi << "]\n";
+      }
+      else
+      {
+         std::string out;
+         for (std::uint64_t p : primes_in_range(lo, hi))
+         {
+            out += std::to_string(p);
+            out += '\n';
+         }
+         std::cout << out;
+      }
+      return 0;
+   }
 
-   int x = std::atoi(argv[1]);
+   std::uint64_t x;
+   if (argc != 2 || !parse_u64(argv[1], x))
+      return usage(argv[0]);
    // Check if number is a prime number
    if (is_prime(x))
       std::cout << x << " is prime.\n";
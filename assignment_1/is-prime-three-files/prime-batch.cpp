@@ -0,0 +1,266 @@
+#include "prime-batch.h"
+#include "only-is-prime.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using u64 = std::uint64_t;
+
+// Numbers per sieve segment: one byte each, so a segment fits in L1
+static const u64 segment_span = 1 << 15;
+
+// Cost of one Miller-Rabin test measured in sieved numbers. A cluster of
+// queries is sieved when its span is cheaper than testing each query.
+static const u64 mr_cost = 512;
+
+// Largest sqrt(hi) the batch path will build base primes for
+static const u64 max_auto_base = 1 << 26;
+
+static u64 isqrt(u64 n)
+{
+   u64 s = static_cast<u64>(std::sqrt(static_cast<double>(n)));
+   s = std::min<u64>(s, 0xFFFFFFFFULL);
+   while (s * s > n)
+      --s;
+   while (s < 0xFFFFFFFFULL && (s + 1) * (s + 1) <= n)
+      ++s;
+   return s;
+}
+
+// Mark flags[i] = 1 iff lo + i is prime, for lo + i in [lo, hi].
+// Needs every odd prime up to sqrt(hi) in primes.
+static void sieve_segment(u64 lo, u64 hi, const std::vector<std::uint32_t> &primes,
+                          std::vector<char> &flags)
+{
+   flags.assign(hi - lo + 1, 0);
+   for (u64 m = lo | 1; m <= hi; m += 2)
+   {
+      flags[m - lo] = 1;
+      if (m >= hi - 1)
+         break;
+   }
+   if (lo <= 1)
+      flags[1 - lo] = 0;
+   if (lo <= 2 && hi >= 2)
+      flags[2 - lo] = 1;
+
+   for (std::uint32_t p : primes)
+   {
+      const u64 pp = static_cast<u64>(p) * p;
+      if (p == 2)
+         continue;
+      if (pp > hi)
+         break;
+      // First odd multiple of p that is >= max(lo, p^2); stop if it would
+      // run past 2^64
+      const u64 rem = lo % p;
+      if (rem != 0 && hi - lo < p - rem)
+         continue;
+      u64 m = std::max(pp, rem == 0 ? lo : lo + (p - rem));
+      if ((m & 1) == 0)
+      {
+         if (hi - m < p)
+            continue;
+         m += p;
+      }
+      const u64 step = 2 * static_cast<u64>(p);
+      while (m <= hi)
+      {
+         flags[m - lo] = 0;
+         if (hi - m < step)
+            break;
+         m += step;
+      }
+   }
+}
+
+// All primes up to limit (limit < 2^32)
+static std::vector<std::uint32_t> base_primes(u64 limit)
+{
+   // Plain sieve up to sqrt(limit), then segments for the rest
+   const u64 small = isqrt(limit);
+   std::vector<char> composite(small + 1, 0);
+   std::vector<std::uint32_t> small_primes;
+   for (u64 i = 2; i <= small; i++)
+   {
+      if (composite[i])
+         continue;
+      small_primes.push_back(static_cast<std::uint32_t>(i));
+      for (u64 j = i * i; j <= small; j += i)
+         composite[j] = 1;
+   }
+
+   std::vector<std::uint32_t> primes;
+   std::vector<char> flags;
+   for (u64 lo = 2; lo <= limit; lo += segment_span)
+   {
+      const u64 hi = std::min(limit, lo + segment_span - 1);
+      sieve_segment(lo, hi, small_primes, flags);
+      for (u64 i = 0; i < flags.size(); i++)
+      {
+         if (flags[i])
+            primes.push_back(static_cast<std::uint32_t>(lo + i));
+      }
+   }
+   return primes;
+}
+
+static u64 num_segments(u64 lo, u64 hi)
+{
+   return (hi - lo) / segment_span + 1;
+}
+
+static u64 segment_hi(u64 seg_lo, u64 hi)
+{
+   return hi - seg_lo < segment_span - 1 ? hi : seg_lo + segment_span - 1;
+}
+
+std::uint64_t count_primes(std::uint64_t lo, std::uint64_t hi)
+{
+   if (hi < 2 || lo > hi)
+      return 0;
+   lo = std::max<u64>(lo, 2);
+   const std::vector<std::uint32_t> primes = base_primes(isqrt(hi));
+   const long long segments = static_cast<long long>(num_segments(lo, hi));
+
+   u64 count = 0;
+#pragma omp parallel
+   {
+      std::vector<char> flags;
+#pragma omp for reduction(+ : count) schedule(dynamic, 16)
+      for (long long s = 0; s < segments; s++)
+      {
+         const u64 seg_lo = lo + s * segment_span;
+         sieve_segment(seg_lo, segment_hi(seg_lo, hi), primes, flags);
+         count += std::count(flags.begin(), flags.end(), 1);
+      }
+   }
+   return count;
+}
+
+std::vector<std::uint64_t> primes_in_range(std::uint64_t lo, std::uint64_t hi)
+{
+   if (hi < 2 || lo > hi)
+      return {};
+   lo = std::max<u64>(lo, 2);
+   const std::vector<std::uint32_t> primes = base_primes(isqrt(hi));
+   const long long segments = static_cast<long long>(num_segments(lo, hi));
+
+   // Each segment collects its own primes; concatenating keeps them sorted
+   std::vector<std::vector<u64>> found(segments);
+#pragma omp parallel
+   {
+      std::vector<char> flags;
+#pragma omp for schedule(dynamic, 16)
+      for (long long s = 0; s < segments; s++)
+      {
+         const u64 seg_lo = lo + s * segment_span;
+         sieve_segment(seg_lo, segment_hi(seg_lo, hi), primes, flags);
+         for (u64 i = 0; i < flags.size(); i++)
+         {
+            if (flags[i])
+               found[s].push_back(seg_lo + i);
+         }
+      }
+   }
+
+   std::vector<u64> result;
+   for (const auto &f : found)
+      result.insert(result.end(), f.begin(), f.end());
+   return result;
+}
+
+std::vector<char> is_prime_batch(const std::vector<std::uint64_t> &numbers)
+{
+   const std::size_t n = numbers.size();
+   std::vector<char> result(n, 0);
+   if (n == 0)
+      return result;
+
+   std::vector<u64> sorted(numbers);
+   std::sort(sorted.begin(), sorted.end());
+   sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+   // Greedy clustering: extending a cluster over a gap g costs g sieved
+   // numbers and saves one Miller-Rabin test, so cut at gaps above mr_cost
+   struct Cluster
+   {
+      std::size_t first, last; // indices into sorted
+   };
+   std::vector<Cluster> sieve_clusters;
+   std::vector<u64> mr_queries;
+   u64 max_sieved = 0;
+   std::size_t first = 0;
+   for (std::size_t i = 1; i <= sorted.size(); i++)
+   {
+      if (i < sorted.size() && sorted[i] - sorted[i - 1] <= mr_cost)
+         continue;
+      const u64 span = sorted[i - 1] - sorted[first] + 1;
+      const u64 k = i - first;
+      if (k > 1 && span / k < mr_cost && isqrt(sorted[i - 1]) <= max_auto_base)
+      {
+         sieve_clusters.push_back({first, i - 1});
+         max_sieved = std::max(max_sieved, sorted[i - 1]);
+      }
+      else
+      {
+         mr_queries.insert(mr_queries.end(), sorted.begin() + first, sorted.begin() + i);
+      }
+      first = i;
+   }
+
+   // Answers for the sorted unique values
+   std::vector<char> answer(sorted.size(), 0);
+
+   // Sieve path: every segment of every dense cluster is one task
+   struct Task
+   {
+      u64 lo, hi;
+   };
+   std::vector<Task> tasks;
+   for (const Cluster &c : sieve_clusters)
+   {
+      const u64 lo = sorted[c.first], hi = sorted[c.last];
+      for (u64 s = 0; s < num_segments(lo, hi); s++)
+      {
+         const u64 seg_lo = lo + s * segment_span;
+         tasks.push_back({seg_lo, segment_hi(seg_lo, hi)});
+      }
+   }
+   if (!tasks.empty())
+   {
+      const std::vector<std::uint32_t> primes = base_primes(isqrt(max_sieved));
+      const long long num_tasks = static_cast<long long>(tasks.size());
+#pragma omp parallel
+      {
+         std::vector<char> flags;
+#pragma omp for schedule(dynamic, 4)
+         for (long long t = 0; t < num_tasks; t++)
+         {
+            const Task &task = tasks[t];
+            sieve_segment(task.lo, task.hi, primes, flags);
+            auto it = std::lower_bound(sorted.begin(), sorted.end(), task.lo);
+            for (; it != sorted.end() && *it <= task.hi; ++it)
+               answer[it - sorted.begin()] = flags[*it - task.lo];
+         }
+      }
+   }
+
+   // Miller-Rabin path
+   const long long num_mr = static_cast<long long>(mr_queries.size());
+#pragma omp parallel for schedule(dynamic, 256)
+   for (long long q = 0; q < num_mr; q++)
+   {
+      auto it = std::lower_bound(sorted.begin(), sorted.end(), mr_queries[q]);
+      answer[it - sorted.begin()] = is_prime(mr_queries[q]);
+   }
+
+   // Back to input order
+#pragma omp parallel for schedule(static)
+   for (long long i = 0; i < static_cast<long long>(n); i++)
+   {
+      auto it = std::lower_bound(sorted.begin(), sorted.end(), numbers[i]);
+      result[i] = answer[it - sorted.begin()];
+   }
+   return result;
+}
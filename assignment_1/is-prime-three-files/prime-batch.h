@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Primality of every number in the batch (1 = prime), in input order.
+// Dense clusters of queries are answered from a segmented sieve, isolated
+// ones by Miller-Rabin.
+std::vector<char> is_prime_batch(const std::vector<std::uint64_t> &numbers);
+
+// Primes in the closed range [lo, hi], by segmented sieve.
+std::uint64_t count_primes(std::uint64_t lo, std::uint64_t hi);
+std::vector<std::uint64_t> primes_in_range(std::uint64_t lo, std::uint64_t hi);
@@ -0,0 +1,145 @@
+#include "cellgrid.h"
+#include <algorithm>
+#include <cmath>
+
+const int CellGrid::stencil_offsets[CellGrid::half_stencil_size][3] = {
+    {0, 0, 1},
+    {0, 1, -1},
+    {0, 1, 0},
+    {0, 1, 1},
+    {1, -1, -1},
+    {1, -1, 0},
+    {1, -1, 1},
+    {1, 0, -1},
+    {1, 0, 0},
+    {1, 0, 1},
+    {1, 1, -1},
+    {1, 1, 0},
+    {1, 1, 1}};
+
+CellGrid::CellGrid(double box_size, double min_cell_size) : box_size(box_size)
+{
+    // Round down so that every cell is at least min_cell_size wide; rounding
+    // up would leave a thin last cell and miss pairs across the boundary.
+    n_side = std::max(1, static_cast<int>(std::floor(box_size / min_cell_size)));
+    side = box_size / n_side;
+
+    const int n_cells = num_cells();
+    starts.resize(n_cells + 1);
+    stencil.resize(n_cells);
+
+#pragma omp parallel for schedule(static)
+    for (int cell_idx = 0; cell_idx < n_cells; cell_idx++)
+    {
+        int cx = cell_idx % n_side;
+        int cy = (cell_idx / n_side) % n_side;
+        int cz = cell_idx / (n_side * n_side);
+        for (int n = 0; n < half_stencil_size; n++)
+        {
+            int nx = (cx + stencil_offsets[n][0] + n_side) % n_side;
+            int ny = (cy + stencil_offsets[n][1] + n_side) % n_side;
+            int nz = (cz + stencil_offsets[n][2] + n_side) % n_side;
+            stencil[cell_idx][n] = nx + ny * n_side + nz * n_side * n_side;
+        }
+    }
+}
+
+int CellGrid::cells_per_side() const
+{
+    return n_side;
+}
+
+int CellGrid::num_cells() const
+{
+    return n_side * n_side * n_side;
+}
+
+double CellGrid::cell_size() const
+{
+    return side;
+}
+
+int CellGrid::cell_of(const std::array<double, 3> &pos) const
+{
+    int c[3];
+    for (int d = 0; d < 3; d++)
+    {
+        // Wrap into the box first; positions need not be pre-wrapped.
+        double x = pos[d] - box_size * std::floor(pos[d] / box_size);
+        c[d] = std::min(n_side - 1, static_cast<int>(x / side));
+    }
+    return c[0] + c[1] * n_side + c[2] * n_side * n_side;
+}
+
+void CellGrid::build(const numa_vector<Molecule> &molecules)
+{
+    const std::size_t n = molecules.size();
+    const int n_cells = num_cells();
+
+    numa_vector<int> cell_idx(n);
+#pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < n; i++)
+    {
+        cell_idx[i] = cell_of(molecules[i].get_coordinates());
+    }
+
+    // Counting sort: a serial scatter keeps the order within a cell stable.
+    std::fill(starts.begin(), starts.end(), 0);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        starts[cell_idx[i] + 1]++;
+    }
+    for (int c = 0; c < n_cells; c++)
+    {
+        starts[c + 1] += starts[c];
+    }
+    slots.resize(n);
+    numa_vector<std::size_t> fill(starts.begin(), starts.end() - 1);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        slots[fill[cell_idx[i]]++] = i;
+    }
+
+    // Gather by cell with the same static schedule as the pair loop.
+    sorted_positions.resize(n);
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < n_cells; c++)
+    {
+        for (std::size_t s = starts[c]; s < starts[c + 1]; s++)
+        {
+            sorted_positions[s] = molecules[slots[s]].get_coordinates();
+        }
+    }
+}
+
+const numa_vector<std::size_t> &CellGrid::cell_start() const
+{
+    return starts;
+}
+
+const numa_vector<std::size_t> &CellGrid::order() const
+{
+    return slots;
+}
+
+const numa_vector<std::array<double, 3>> &CellGrid::positions() const
+{
+    return sorted_positions;
+}
+
+const std::array<int, CellGrid::half_stencil_size> &CellGrid::half_stencil(int cell) const
+{
+    return stencil[cell];
+}
+
+std::array<double, 3> CellGrid::stencil_shift(int cell, int n) const
+{
+    const int c[3] = {cell % n_side, (cell / n_side) % n_side, cell / (n_side * n_side)};
+    std::array<double, 3> shift;
+    for (int d = 0; d < 3; d++)
+    {
+        const int target = c[d] + stencil_offsets[n][d];
+        shift[d] = target < 0 ? -box_size : (target >= n_side ? box_size : 0.0);
+    }
+    return shift;
+}
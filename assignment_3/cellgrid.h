@@ -0,0 +1,52 @@
+// cellgrid.h
+#ifndef CELLGRID_H
+#define CELLGRID_H
+
+#include "molecule.h"
+#include "numa.h"
+#include <array>
+#include <cstddef>
+
+// Linked-cell grid over a cubic periodic box, stored as flat arrays sorted by
+// cell (z slowest) so that a static block of cells is also a contiguous block
+// of memory. The grid needs at least 3 cells per side; with fewer the half
+// stencil would visit the same neighbour cell more than once.
+class CellGrid
+{
+public:
+    static const int half_stencil_size = 13;
+    // Cell offsets (dx, dy, dz) of the half stencil.
+    static const int stencil_offsets[half_stencil_size][3];
+
+    CellGrid(double box_size, double min_cell_size);
+
+    // Bin all molecules and gather their positions in cell order.
+    void build(const numa_vector<Molecule> &molecules);
+
+    int cells_per_side() const;
+    int num_cells() const;
+    double cell_size() const;
+    int cell_of(const std::array<double, 3> &pos) const;
+
+    // Particles of cell c occupy slots [cell_start[c], cell_start[c + 1]).
+    const numa_vector<std::size_t> &cell_start() const;
+    // Index into the molecule store for each cell-ordered slot.
+    const numa_vector<std::size_t> &order() const;
+    const numa_vector<std::array<double, 3>> &positions() const;
+    // The 13 "forward" neighbours of a cell; each cell pair is visited once.
+    const std::array<int, half_stencil_size> &half_stencil(int cell) const;
+    // Image shift to add to positions in half_stencil(cell)[n] so that they
+    // sit next to cell in real space (non-zero only across the boundary).
+    std::array<double, 3> stencil_shift(int cell, int n) const;
+
+private:
+    double box_size;
+    int n_side;
+    double side;
+    numa_vector<std::size_t> starts;
+    numa_vector<std::size_t> slots;
+    numa_vector<std::array<double, 3>> sorted_positions;
+    numa_vector<std::array<int, half_stencil_size>> stencil;
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "clusterpairs.h"
+#include "molecularsystem.h"
+#include "reduction.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+ClusterPairList::ClusterPairList(double box_size, double cutoff, int cluster_size)
+    : box_size(box_size), cutoff(cutoff), M(cluster_size)
+{
+    if (M != 4 && M != 8)
+    {
+        throw std::invalid_argument("cluster size must be 4 or 8");
+    }
+    for (int k = 0; k < 27; k++)
+    {
+        shifts[k] = {(k % 3 - 1) * box_size, (k / 3 % 3 - 1) * box_size, (k / 9 - 1) * box_size};
+    }
+}
+
+int ClusterPairList::cluster_size() const
+{
+    return M;
+}
+
+std::size_t ClusterPairList::num_clusters() const
+{
+    return count.size();
+}
+
+std::size_t ClusterPairList::num_cluster_pairs() const
+{
+    return pairs.size();
+}
+
+void ClusterPairList::build(const CellGrid &grid)
+{
+    const int n_cells = grid.num_cells();
+    const auto &cell_start = grid.cell_start();
+    const auto &pos = grid.positions();
+
+    // Clusters never straddle cells
+    std::vector<std::size_t> cluster_start(n_cells + 1, 0);
+    for (int c = 0; c < n_cells; c++)
+    {
+        const std::size_t n_c = cell_start[c + 1] - cell_start[c];
+        cluster_start[c + 1] = cluster_start[c] + (n_c + M - 1) / M;
+    }
+    const std::size_t n_clusters = cluster_start[n_cells];
+    xs.assign(n_clusters * M, 0.0);
+    ys.assign(n_clusters * M, 0.0);
+    zs.assign(n_clusters * M, 0.0);
+    count.assign(n_clusters, 0);
+    bbox.resize(n_clusters);
+
+    // Pack: sort each cell along z so that consecutive groups of M are
+    // compact slabs, wrap into the box, pad with masked slots.
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < n_cells; c++)
+    {
+        std::vector<std::size_t> local(cell_start[c + 1] - cell_start[c]);
+        std::iota(local.begin(), local.end(), cell_start[c]);
+        std::sort(local.begin(), local.end(), [&](std::size_t a, std::size_t b)
+                  { return pos[a][2] < pos[b][2]; });
+        for (std::size_t k = 0; k < local.size(); k++)
+        {
+            const std::size_t cl = cluster_start[c] + k / M;
+            const std::size_t slot = cl * M + k % M;
+            std::array<double, 3> p = pos[local[k]];
+            for (int d = 0; d < 3; d++)
+            {
+                p[d] -= box_size * std::floor(p[d] / box_size);
+            }
+            xs[slot] = p[0];
+            ys[slot] = p[1];
+            zs[slot] = p[2];
+            count[cl]++;
+        }
+        for (std::size_t cl = cluster_start[c]; cl < cluster_start[c + 1]; cl++)
+        {
+            std::array<double, 6> b = {xs[cl * M], ys[cl * M], zs[cl * M],
+                                       xs[cl * M], ys[cl * M], zs[cl * M]};
+            for (int a = 1; a < count[cl]; a++)
+            {
+                const double p[3] = {xs[cl * M + a], ys[cl * M + a], zs[cl * M + a]};
+                for (int d = 0; d < 3; d++)
+                {
+                    b[d] = std::min(b[d], p[d]);
+                    b[d + 3] = std::max(b[d + 3], p[d]);
+                }
+            }
+            bbox[cl] = b;
+        }
+    }
+
+    const double rc2 = cutoff * cutoff;
+    auto within = [&](std::size_t i, std::size_t j, const std::array<double, 3> &s)
+    {
+        double gap2 = 0.0;
+        for (int d = 0; d < 3; d++)
+        {
+            const double gap = std::max({0.0, bbox[j][d] + s[d] - bbox[i][d + 3],
+                                         bbox[i][d] - bbox[j][d + 3] - s[d]});
+            gap2 += gap * gap;
+        }
+        return gap2 < rc2;
+    };
+
+    // Two passes over the same candidates: count, then fill the CSR list
+    pair_start.assign(n_clusters + 1, 0);
+    for (int fill = 0; fill < 2; fill++)
+    {
+        if (fill)
+        {
+            for (std::size_t i = 0; i < n_clusters; i++)
+            {
+                pair_start[i + 1] += pair_start[i];
+            }
+            pairs.resize(pair_start[n_clusters]);
+        }
+#pragma omp parallel for schedule(static)
+        for (int c = 0; c < n_cells; c++)
+        {
+            for (std::size_t i = cluster_start[c]; i < cluster_start[c + 1]; i++)
+            {
+                std::size_t n_pairs = 0;
+                auto add = [&](std::size_t j, int shift)
+                {
+                    if (fill)
+                        pairs[pair_start[i] + n_pairs] = {static_cast<int>(j), shift};
+                    n_pairs++;
+                };
+                // Same cell: j >= i, including the cluster with itself
+                for (std::size_t j = i; j < cluster_start[c + 1]; j++)
+                {
+                    if (j == i || within(i, j, shifts[13]))
+                        add(j, 13);
+                }
+                for (int n = 0; n < CellGrid::half_stencil_size; n++)
+                {
+                    const int nb = grid.half_stencil(c)[n];
+                    const std::array<double, 3> s = grid.stencil_shift(c, n);
+                    const int shift = static_cast<int>(std::lround(s[0] / box_size)) + 1 +
+                                      3 * (static_cast<int>(std::lround(s[1] / box_size)) + 1) +
+                                      9 * (static_cast<int>(std::lround(s[2] / box_size)) + 1);
+                    for (std::size_t j = cluster_start[nb]; j < cluster_start[nb + 1]; j++)
+                    {
+                        if (within(i, j, shifts[shift]))
+                            add(j, shift);
+                    }
+                }
+                if (!fill)
+                    pair_start[i + 1] = n_pairs;
+            }
+        }
+    }
+}
+
+template <int M>
+double ClusterPairList::energy(bool reproducible) const
+{
+    // Shifted LJ in reduced units, as lj_pair_energy with epsilon = sigma = 1
+    const double rc2 = cutoff * cutoff;
+    const double ic6 = 1.0 / (rc2 * rc2 * rc2);
+    const double u_cut = 4.0 * (ic6 * ic6 - ic6);
+    const long n_clusters = static_cast<long>(count.size());
+    double potential_energy = 0.0;
+    // Reproducible mode: one partial sum per cluster i
+    numa_vector<double> rows(reproducible ? n_clusters : 0);
+
+#pragma omp parallel for reduction(+ : potential_energy) schedule(static)
+    for (long i = 0; i < n_clusters; i++)
+    {
+        const double *xi = &xs[i * M], *yi = &ys[i * M], *zi = &zs[i * M];
+        const int ni = count[i];
+        double row = 0.0;
+        for (std::size_t p = pair_start[i]; p < pair_start[i + 1]; p++)
+        {
+            const long j = pairs[p].j;
+            const std::array<double, 3> &s = shifts[pairs[p].shift];
+            const double *xj = &xs[j * M], *yj = &ys[j * M], *zj = &zs[j * M];
+            const int nj = count[j];
+            const bool self = j == i;
+
+            // Dense M x M block; padding, the lower triangle of a self pair
+            // and pairs beyond the cutoff are masked out, not branched around
+            double block = 0.0;
+            for (int a = 0; a < M; a++)
+            {
+#pragma omp simd reduction(+ : block)
+                for (int b = 0; b < M; b++)
+                {
+                    const double dx = xi[a] - xj[b] - s[0];
+                    const double dy = yi[a] - yj[b] - s[1];
+                    const double dz = zi[a] - zj[b] - s[2];
+                    const double r2 = dx * dx + dy * dy + dz * dz;
+                    const bool keep = (a < ni) & (b < nj) & (!self | (b > a)) &
+                                      (r2 < rc2) & (r2 >= 1e-12);
+                    const double inv_r2 = 1.0 / (keep ? r2 : 1.0);
+                    const double inv_r6 = inv_r2 * inv_r2 * inv_r2;
+                    block += keep ? 4.0 * (inv_r6 * inv_r6 - inv_r6) - u_cut : 0.0;
+                }
+            }
+            row += block;
+        }
+        if (reproducible)
+            rows[i] = row;
+        else
+            potential_energy += row;
+    }
+    return reproducible ? reproducible_sum(rows) : potential_energy;
+}
+
+double ClusterPairList::potential_energy(bool reproducible) const
+{
+    return M == 8 ? energy<8>(reproducible) : energy<4>(reproducible);
+}
+
+// MolecularSystem backend; defined here so that only binaries using it link
+// the cluster-pair lists.
+double MolecularSystem::total_potential_energy_ClusterPairs(int cluster_size) const
+{
+    const double cell_size = 2.5;
+    CellGrid grid(box_size, cell_size);
+    if (grid.cells_per_side() < 3)
+    {
+        return total_potential_energy_SmallBox();
+    }
+    grid.build(molecules);
+
+    ClusterPairList list(box_size, cell_size, cluster_size);
+    list.build(grid);
+    return list.potential_energy(reproducible_sums);
+}
@@ -0,0 +1,56 @@
+// clusterpairs.h
+#ifndef CLUSTERPAIRS_H
+#define CLUSTERPAIRS_H
+
+#include "cellgrid.h"
+#include "molecule.h"
+#include "numa.h"
+#include <array>
+#include <cstddef>
+
+// Cluster-pair neighbour list for SIMD pair evaluation. Particles of each
+// cell are grouped into spatial clusters of 4 or 8 (the SIMD width), stored
+// as padded x/y/z arrays. The list holds cluster pairs whose bounding boxes
+// come within the cutoff, together with the periodic image shift of the
+// second cluster, and each pair is evaluated as a dense masked block with
+// plain Euclidean distances.
+class ClusterPairList
+{
+public:
+    struct ClusterPair
+    {
+        int j;
+        int shift; // index into shifts
+    };
+
+    ClusterPairList(double box_size, double cutoff, int cluster_size);
+
+    // Needs a grid with at least 3 cells per side.
+    void build(const CellGrid &grid);
+
+    // With reproducible set, the per-cluster sums are combined by
+    // reproducible_sum(), independent of the thread count.
+    double potential_energy(bool reproducible = false) const;
+
+    int cluster_size() const;
+    std::size_t num_clusters() const;
+    std::size_t num_cluster_pairs() const;
+
+private:
+    template <int M>
+    double energy(bool reproducible) const;
+
+    double box_size, cutoff;
+    int M;
+    // Slots c*M .. c*M + M - 1 hold cluster c; count[c] of them are real.
+    numa_vector<double> xs, ys, zs;
+    numa_vector<int> count;
+    numa_vector<std::array<double, 6>> bbox; // lo x, y, z, hi x, y, z
+    // Pairs of cluster i are pairs[pair_start[i] .. pair_start[i + 1]).
+    numa_vector<std::size_t> pair_start;
+    numa_vector<ClusterPair> pairs;
+    // All 27 image shifts; index 13 is zero.
+    std::array<std::array<double, 3>, 27> shifts;
+};
+
+#endif
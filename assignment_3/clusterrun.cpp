@@ -0,0 +1,131 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <algorithm>
+
+#include "molecule.h"
+#include "clusters.h"
+#include "trajectory.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+
+// Breadth-first search over all pairs, for --check on small frames
+static std::vector<long> brute_force_sizes(const numa_vector<Molecule> &molecules, double box_size, double bond)
+{
+    const std::size_t n = molecules.size();
+    std::vector<int> seen(n, 0);
+    std::vector<long> sizes;
+    for (std::size_t start = 0; start < n; start++)
+    {
+        if (seen[start])
+            continue;
+        std::vector<std::size_t> stack{start};
+        seen[start] = 1;
+        long size = 0;
+        while (!stack.empty())
+        {
+            const std::size_t i = stack.back();
+            stack.pop_back();
+            size++;
+            for (std::size_t j = 0; j < n; j++)
+            {
+                if (seen[j])
+                    continue;
+                double r2 = 0.0;
+                for (int d = 0; d < 3; d++)
+                {
+                    double dx = molecules[i].get_coordinates()[d] - molecules[j].get_coordinates()[d];
+                    dx -= box_size * std::round(dx / box_size);
+                    r2 += dx * dx;
+                }
+                if (r2 < bond * bond)
+                {
+                    seen[j] = 1;
+                    stack.push_back(j);
+                }
+            }
+        }
+        sizes.push_back(size);
+    }
+    std::sort(sizes.rbegin(), sizes.rend());
+    return sizes;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> files;
+    bool check = false;
+    for (int k = 1; k < argc; k++)
+    {
+        if (std::string(argv[k]) == "--check")
+            check = true;
+        else
+            files.push_back(argv[k]);
+    }
+    if (files.size() < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <box_size> <bond_distance> <positions_file>... [--check]\n"
+                  << "  .trj files contribute every frame, XYZ files their first frame.\n";
+        return 1;
+    }
+    const double box_size = std::atof(files[0].c_str());
+    const double bond = std::atof(files[1].c_str());
+
+    pin_threads();
+    std::map<long, long> distribution;
+    long frames = 0, mismatches = 0;
+    double total_ms = 0.0;
+    auto analyse = [&](const std::vector<std::array<double, 3>> &x, double box)
+    {
+        numa_vector<Molecule> molecules;
+        molecules.reserve(x.size());
+        for (std::size_t i = 0; i < x.size(); i++)
+            molecules.push_back(Molecule(static_cast<int>(i), x[i][0], x[i][1], x[i][2]));
+        auto start = std::chrono::steady_clock::now();
+        const ClusterResult r = find_clusters(molecules, box, bond);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        total_ms += elapsed.count();
+        for (const auto &d : r.distribution)
+            distribution[d.first] += d.second;
+        std::cout << frames++ << " " << r.sizes.size() << " " << r.largest() << " " << elapsed.count() << "\n";
+        if (check)
+            mismatches += brute_force_sizes(molecules, box, bond) != r.sizes;
+    };
+
+    try
+    {
+        std::cout << "# frame clusters largest ms\n";
+        for (std::size_t f = 2; f < files.size(); f++)
+        {
+            if (is_trajectory_file(files[f]))
+            {
+                TrajectoryReader reader(files[f]);
+                for (std::size_t k = 0; k < reader.num_frames(); k++)
+                    analyse(reader.read_frame(k), reader.box_size());
+            }
+            else
+            {
+                analyse(readXYZPositions(box_size, files[f]), box_size);
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::cout << "# " << frames << " frames, " << total_ms / std::max(frames, 1L) << " ms per frame\n"
+              << "# size clusters (over all frames)\n";
+    for (const auto &d : distribution)
+        std::cout << d.first << " " << d.second << "\n";
+    if (check)
+        std::cout << "# Frames differing from a brute-force search: " << mismatches << "\n";
+    return mismatches ? 1 : 0;
+}
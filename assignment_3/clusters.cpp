@@ -0,0 +1,174 @@
+#include "clusters.h"
+#include "cellgrid.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+class ConcurrentUnionFind
+{
+public:
+    explicit ConcurrentUnionFind(long n) : parent(new std::atomic<int>[n])
+    {
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < n; i++)
+            parent[i].store(static_cast<int>(i), std::memory_order_relaxed);
+    }
+
+    int find(int x)
+    {
+        while (true)
+        {
+            int p = parent[x].load(std::memory_order_relaxed);
+            if (p == x)
+                return x;
+            const int gp = parent[p].load(std::memory_order_relaxed);
+            // Path halving; losing the race only means less compression
+            if (p != gp)
+                parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+            x = gp;
+        }
+    }
+
+    void unite(int a, int b)
+    {
+        while (true)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return;
+            if (a < b)
+                std::swap(a, b);
+            // Only a root may be linked; retry if a stopped being one
+            int expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+                return;
+        }
+    }
+
+private:
+    std::unique_ptr<std::atomic<int>[]> parent;
+};
+} // namespace
+
+ClusterResult find_clusters(const numa_vector<Molecule> &molecules, double box_size, double bond_distance)
+{
+    if (bond_distance <= 0.0 || bond_distance > 0.5 * box_size)
+        throw std::invalid_argument("bond distance must be between 0 and half the box");
+    const long n = static_cast<long>(molecules.size());
+    const double b2 = bond_distance * bond_distance;
+    ConcurrentUnionFind sets(n);
+
+    CellGrid grid(box_size, bond_distance);
+    if (grid.cells_per_side() < 3)
+    {
+        // Too few cells for the half stencil: all pairs, minimum image
+#pragma omp parallel for schedule(dynamic, 64)
+        for (long i = 0; i < n; i++)
+        {
+            const auto &xi = molecules[i].get_coordinates();
+            for (long j = i + 1; j < n; j++)
+            {
+                const auto &xj = molecules[j].get_coordinates();
+                double r2 = 0.0;
+                for (int d = 0; d < 3; d++)
+                {
+                    double dx = xi[d] - xj[d];
+                    dx -= box_size * std::round(dx / box_size);
+                    r2 += dx * dx;
+                }
+                if (r2 < b2)
+                    sets.unite(static_cast<int>(i), static_cast<int>(j));
+            }
+        }
+    }
+    else
+    {
+        grid.build(molecules);
+        const auto &cell_start = grid.cell_start();
+        const auto &order = grid.order();
+        const auto &raw = grid.positions();
+        // The stencil shifts assume wrapped positions
+        numa_vector<std::array<double, 3>> pos(n);
+#pragma omp parallel for schedule(static)
+        for (long s = 0; s < n; s++)
+        {
+            for (int d = 0; d < 3; d++)
+                pos[s][d] = raw[s][d] - box_size * std::floor(raw[s][d] / box_size);
+        }
+
+        auto bonded = [&](std::size_t s, std::size_t t, const std::array<double, 3> &shift)
+        {
+            double r2 = 0.0;
+            for (int d = 0; d < 3; d++)
+            {
+                const double dx = pos[s][d] - pos[t][d] - shift[d];
+                r2 += dx * dx;
+            }
+            return r2 < b2;
+        };
+
+        const int n_cells = grid.num_cells();
+#pragma omp parallel for schedule(dynamic, 16)
+        for (int c = 0; c < n_cells; c++)
+        {
+            const std::array<double, 3> none{0.0, 0.0, 0.0};
+            for (std::size_t s = cell_start[c]; s < cell_start[c + 1]; s++)
+            {
+                for (std::size_t t = s + 1; t < cell_start[c + 1]; t++)
+                    if (bonded(s, t, none))
+                        sets.unite(static_cast<int>(order[s]), static_cast<int>(order[t]));
+            }
+            for (int k = 0; k < CellGrid::half_stencil_size; k++)
+            {
+                const int nb = grid.half_stencil(c)[k];
+                const auto shift = grid.stencil_shift(c, k);
+                for (std::size_t s = cell_start[c]; s < cell_start[c + 1]; s++)
+                    for (std::size_t t = cell_start[nb]; t < cell_start[nb + 1]; t++)
+                        if (bonded(s, t, shift))
+                            sets.unite(static_cast<int>(order[s]), static_cast<int>(order[t]));
+            }
+        }
+    }
+
+    // Roots are the smallest member of each cluster. Count members per root,
+    // then number the roots by decreasing size.
+    ClusterResult result;
+    result.cluster.resize(n);
+    std::vector<long> count(n, 0);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        result.cluster[i] = sets.find(static_cast<int>(i));
+    }
+    for (long i = 0; i < n; i++)
+        count[result.cluster[i]]++;
+    std::vector<int> roots;
+    for (long i = 0; i < n; i++)
+        if (count[i] > 0)
+            roots.push_back(static_cast<int>(i));
+    std::stable_sort(roots.begin(), roots.end(), [&](int a, int b)
+                     { return count[a] > count[b]; });
+    std::vector<int> number(n, -1);
+    for (std::size_t k = 0; k < roots.size(); k++)
+    {
+        number[roots[k]] = static_cast<int>(k);
+        result.sizes.push_back(count[roots[k]]);
+    }
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        result.cluster[i] = number[result.cluster[i]];
+    }
+    for (auto it = result.sizes.rbegin(); it != result.sizes.rend(); ++it)
+    {
+        if (result.distribution.empty() || result.distribution.back().first != *it)
+            result.distribution.push_back({*it, 0});
+        result.distribution.back().second++;
+    }
+    return result;
+}
@@ -0,0 +1,30 @@
+// clusters.h
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include "molecule.h"
+#include "numa.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+struct ClusterResult
+{
+    // Cluster of each molecule; clusters are numbered by decreasing size
+    // (ties by lowest member), so cluster 0 is the largest.
+    numa_vector<int> cluster;
+    std::vector<long> sizes;
+    // (cluster size, number of clusters of that size), by increasing size
+    std::vector<std::pair<long, long>> distribution;
+
+    long largest() const { return sizes.empty() ? 0 : sizes[0]; }
+};
+
+// Connected components of the graph linking molecules closer than
+// bond_distance (minimum image). Pairs come from the half stencil of a cell
+// grid with bond_distance cells, visited in parallel; every bonded pair is
+// merged into a lock-free union-find (CAS linking of roots, larger index
+// under smaller, with path halving), so no thread ever waits on a lock.
+ClusterResult find_clusters(const numa_vector<Molecule> &molecules, double box_size, double bond_distance);
+
+#endif
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+
+#include "correlator.h"
+#include "trajectory.h"
+
+// MSD and diffusion coefficient of a compressed trajectory, streamed frame
+// by frame (the frames never have to fit in memory together).
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || argc > 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <frame_interval> <in.trj> [<block>]\n";
+        return 1;
+    }
+    const double interval = std::atof(argv[1]);
+    const int block = argc == 4 ? std::atoi(argv[3]) : 16;
+    try
+    {
+        TrajectoryReader reader(argv[2]);
+        MultiTauCorrelator correlator(reader.num_atoms(), reader.box_size(), interval, block);
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t k = 0; k < reader.num_frames(); k++)
+        {
+            correlator.sample(reader.read_frame(k));
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "# " << correlator.samples() << " frames, " << reader.num_atoms() << " atoms, "
+                  << elapsed.count() << " ms\n# lag MSD samples\n";
+        for (const auto &c : correlator.results())
+            std::cout << c.lag << " " << c.msd << " " << c.samples << "\n";
+        std::cout << "# D (MSD slope) = " << correlator.diffusion_msd() << "\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
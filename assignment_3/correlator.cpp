@@ -0,0 +1,184 @@
+#include "correlator.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+MultiTauCorrelator::MultiTauCorrelator(std::size_t n_particles, double box_size, double sample_interval,
+                                       int block, int averaging)
+    : n(n_particles), box_size(box_size), dt(sample_interval), block(block), averaging(averaging)
+{
+    if (block < 2 || averaging < 2 || block % averaging != 0)
+        throw std::invalid_argument("correlator block must be a multiple of the averaging factor");
+    unwrapped.resize(3 * n);
+    last.resize(3 * n);
+    velocity.resize(3 * n);
+}
+
+long MultiTauCorrelator::samples() const
+{
+    return n_samples;
+}
+
+void MultiTauCorrelator::sample(const numa_vector<Molecule> &molecules)
+{
+    take([&](std::size_t i, std::array<double, 3> &x, std::array<double, 3> &v)
+         {
+             x = molecules[i].get_coordinates();
+             v = molecules[i].get_velocities(); },
+         true);
+}
+
+void MultiTauCorrelator::sample(const std::vector<std::array<double, 3>> &positions,
+                                const std::vector<std::array<double, 3>> *velocities)
+{
+    take([&](std::size_t i, std::array<double, 3> &x, std::array<double, 3> &v)
+         {
+             x = positions[i];
+             v = velocities ? (*velocities)[i] : std::array<double, 3>{0.0, 0.0, 0.0}; },
+         velocities != nullptr);
+}
+
+template <typename Frame>
+void MultiTauCorrelator::take(Frame frame, bool with_velocities)
+{
+    has_velocities = has_velocities && with_velocities;
+    const long count = static_cast<long>(n);
+    const bool first = n_samples == 0;
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < count; i++)
+    {
+        std::array<double, 3> x, v;
+        frame(i, x, v);
+        for (int d = 0; d < 3; d++)
+        {
+            // Minimum-image step since the last sample undoes any wrap
+            double step = first ? 0.0 : x[d] - last[3 * i + d];
+            step -= box_size * std::round(step / box_size);
+            unwrapped[3 * i + d] = first ? x[d] : unwrapped[3 * i + d] + step;
+            last[3 * i + d] = x[d];
+            velocity[3 * i + d] = v[d];
+        }
+    }
+    push(0, unwrapped.data(), velocity.data());
+    n_samples++;
+}
+
+void MultiTauCorrelator::push(std::size_t k, const double *x, const double *v)
+{
+    const std::size_t width = 3 * n;
+    if (k == levels.size())
+    {
+        Level level;
+        level.pos.resize(block * width);
+        level.vel.resize(block * width);
+        level.acc_pos.assign(width, 0.0);
+        level.acc_vel.assign(width, 0.0);
+        level.msd.assign(block, 0.0);
+        level.vacf.assign(block, 0.0);
+        level.count.assign(block, 0);
+        levels.push_back(std::move(level));
+    }
+    Level &level = levels[k];
+    const int slot = static_cast<int>(level.inserted % block);
+    std::copy(x, x + width, level.pos.begin() + slot * width);
+    std::copy(v, v + width, level.vel.begin() + slot * width);
+    level.inserted++;
+
+    // Lags below block / averaging are covered more finely by the level below
+    const int j_first = k == 0 ? 0 : block / averaging;
+    const int j_last = static_cast<int>(std::min<long>(block, level.inserted));
+    if (j_first < j_last)
+    {
+        std::vector<double> msd(block, 0.0), vacf(block, 0.0);
+        double *m = msd.data(), *c = vacf.data();
+        const double *pos = level.pos.data(), *vel = level.vel.data();
+        const long w = static_cast<long>(width);
+#pragma omp parallel for reduction(+ : m[:block], c[:block]) schedule(static)
+        for (long e = 0; e < w; e++)
+        {
+            const double xe = pos[slot * width + e], ve = vel[slot * width + e];
+            for (int j = j_first; j < j_last; j++)
+            {
+                const std::size_t other = ((slot - j + block) % block) * width + e;
+                const double dx = xe - pos[other];
+                m[j] += dx * dx;
+                c[j] += ve * vel[other];
+            }
+        }
+        for (int j = j_first; j < j_last; j++)
+        {
+            level.msd[j] += msd[j] / n;
+            level.vacf[j] += vacf[j] / n;
+            level.count[j]++;
+        }
+    }
+
+    for (std::size_t e = 0; e < width; e++)
+    {
+        level.acc_pos[e] += x[e];
+        level.acc_vel[e] += v[e];
+    }
+    if (++level.accumulated == averaging)
+    {
+        std::vector<double> ax(width), av(width);
+        for (std::size_t e = 0; e < width; e++)
+        {
+            ax[e] = level.acc_pos[e] / averaging;
+            av[e] = level.acc_vel[e] / averaging;
+        }
+        std::fill(level.acc_pos.begin(), level.acc_pos.end(), 0.0);
+        std::fill(level.acc_vel.begin(), level.acc_vel.end(), 0.0);
+        level.accumulated = 0;
+        // May reallocate levels; level is not used after this
+        push(k + 1, ax.data(), av.data());
+    }
+}
+
+std::vector<CorrelationPoint> MultiTauCorrelator::results() const
+{
+    std::vector<CorrelationPoint> out;
+    double scale = dt;
+    for (std::size_t k = 0; k < levels.size(); k++, scale *= averaging)
+    {
+        const Level &level = levels[k];
+        for (int j = k == 0 ? 0 : block / averaging; j < block; j++)
+        {
+            if (level.count[j] == 0)
+                continue;
+            out.push_back({j * scale, level.msd[j] / level.count[j],
+                           has_velocities ? level.vacf[j] / level.count[j] : 0.0, level.count[j]});
+        }
+    }
+    return out;
+}
+
+double MultiTauCorrelator::diffusion_msd() const
+{
+    const auto points = results();
+    if (points.size() < 2)
+        return 0.0;
+    const double t_from = points.back().lag / 10.0;
+    double st = 0.0, sm = 0.0, stt = 0.0, stm = 0.0;
+    int used = 0;
+    for (const auto &p : points)
+    {
+        if (p.lag < t_from)
+            continue;
+        st += p.lag;
+        sm += p.msd;
+        stt += p.lag * p.lag;
+        stm += p.lag * p.msd;
+        used++;
+    }
+    const double denom = used * stt - st * st;
+    return used > 1 && denom > 0.0 ? (used * stm - st * sm) / denom / 6.0 : 0.0;
+}
+
+double MultiTauCorrelator::diffusion_vacf() const
+{
+    const auto points = results();
+    double integral = 0.0;
+    for (std::size_t p = 1; p < points.size(); p++)
+        integral += 0.5 * (points[p].vacf + points[p - 1].vacf) * (points[p].lag - points[p - 1].lag);
+    return integral / 3.0;
+}
@@ -0,0 +1,69 @@
+// correlator.h
+#ifndef CORRELATOR_H
+#define CORRELATOR_H
+
+#include "molecule.h"
+#include "numa.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+struct CorrelationPoint
+{
+    double lag;
+    double msd;  // <|r(t + lag) - r(t)|^2>, unwrapped
+    double vacf; // <v(t) . v(t + lag)>
+    long samples;
+};
+
+// Online multi-tau correlator for the mean squared displacement and the
+// velocity autocorrelation. Level 0 keeps the last `block` samples and
+// correlates every new sample against them; every `averaging` samples of a
+// level are averaged and pushed to the next level, whose lags are
+// `averaging` times longer. Levels are added as the run grows, so memory is
+// O(N block log T) instead of O(N T), and lags grow geometrically up to the
+// run length. Positions are unwrapped across periodic wraps, which needs
+// every particle to move less than half the box between samples.
+class MultiTauCorrelator
+{
+public:
+    MultiTauCorrelator(std::size_t n_particles, double box_size, double sample_interval,
+                       int block = 16, int averaging = 2);
+
+    void sample(const numa_vector<Molecule> &molecules);
+    // Trajectory frames; without velocities the VACF stays zero.
+    void sample(const std::vector<std::array<double, 3>> &positions,
+                const std::vector<std::array<double, 3>> *velocities = nullptr);
+
+    long samples() const;
+    std::vector<CorrelationPoint> results() const;
+    // D from the MSD slope over the last decade of lags, / 6.
+    double diffusion_msd() const;
+    // D from the Green-Kubo integral of the VACF (trapezoid), / 3.
+    double diffusion_vacf() const;
+
+private:
+    struct Level
+    {
+        std::vector<double> pos, vel;         // block x 3N ring buffers
+        std::vector<double> acc_pos, acc_vel; // running sums for the next level
+        int accumulated = 0;
+        long inserted = 0;
+        std::vector<double> msd, vacf;
+        std::vector<long> count;
+    };
+
+    template <typename Frame>
+    void take(Frame frame, bool with_velocities);
+    void push(std::size_t k, const double *x, const double *v);
+
+    std::size_t n;
+    double box_size, dt;
+    int block, averaging;
+    long n_samples = 0;
+    bool has_velocities = true;
+    std::vector<double> unwrapped, last, velocity;
+    std::vector<Level> levels;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "molecule.h"
+#include "molecularsystem.h"
+#include "energyserver.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+
+int serve(const std::string &socket_path)
+{
+    pin_threads();
+    EnergyServer server(socket_path);
+    std::cout << "Listening on " << socket_path << "\n";
+    server.serve();
+    const ServerStats &s = server.stats();
+    std::cout << "Served " << s.requests << " requests, " << s.list_builds << " list builds, "
+              << s.list_reuses << " reuses.\n";
+    return 0;
+}
+
+// Optimizer-like load: calls on slightly displaced copies of one configuration.
+int bench(const std::string &socket_path, double box_size, const std::string &file, long calls,
+          bool with_forces, bool use_shm)
+{
+    auto positions = readXYZPositions(box_size, file);
+    const std::size_t n = positions.size();
+    MolecularSystem system(box_size);
+    system.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        system.add_molecule(Molecule(static_cast<int>(i), positions[i][0], positions[i][1], positions[i][2]));
+    const double reference = system.total_potential_energy_LinkedCells();
+
+    EnergyClient client(socket_path);
+    std::string shm_name;
+    double *shm = nullptr;
+    const std::size_t shm_bytes = 6 * n * sizeof(double);
+    if (use_shm)
+    {
+        shm_name = "/molsim-energyd-" + std::to_string(::getpid());
+        const int fd = ::shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0 || ::ftruncate(fd, shm_bytes) < 0)
+        {
+            std::cerr << "Error: cannot create shared memory " << shm_name << "\n";
+            return 1;
+        }
+        shm = static_cast<double *>(::mmap(nullptr, shm_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        ::close(fd);
+    }
+
+    auto call = [&](std::vector<std::array<double, 3>> *forces)
+    {
+        if (!use_shm)
+            return client.energy(positions, box_size, forces);
+        std::memcpy(shm, positions.data(), 3 * n * sizeof(double));
+        return client.energy_shm(shm_name, n, box_size, forces != nullptr);
+    };
+
+    std::vector<std::array<double, 3>> forces;
+    const auto first = call(with_forces ? &forces : nullptr);
+    std::cout << "Server energy: " << first.energy << " (LinkedCells " << reference << ")\n";
+
+    std::mt19937_64 gen(1);
+    std::uniform_real_distribution<double> jitter(-1e-3, 1e-3);
+    double server_ms = 0.0;
+    long reused = 0, failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long c = 0; c < calls; c++)
+    {
+        for (auto &p : positions)
+            for (double &x : p)
+                x += jitter(gen);
+        const auto reply = call(with_forces ? &forces : nullptr);
+        server_ms += reply.ms_compute;
+        reused += reply.list_reused;
+        failed += reply.status != 0;
+    }
+    std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+
+    if (use_shm)
+    {
+        ::munmap(shm, shm_bytes);
+        ::shm_unlink(shm_name.c_str());
+    }
+    std::cout << calls << " calls (N = " << n << (with_forces ? ", forces" : "") << (use_shm ? ", shm" : "")
+              << "): " << total.count() / calls << " ms per call, " << server_ms / calls
+              << " ms of it in the server; list reused " << reused << " times, " << failed << " failures.\n";
+    return failed ? 1 : 0;
+}
+
+// Requests with a NaN or infinite coordinate are rejected with status 4,
+// and the server still answers the next client.
+int check(const std::string &socket_path, double box_size, const std::string &file)
+{
+    const auto positions = readXYZPositions(box_size, file);
+    const double expected = EnergyClient(socket_path).energy(positions, box_size).energy;
+    bool ok = true;
+    for (double bad : {std::nan(""), HUGE_VAL, -HUGE_VAL})
+    {
+        auto broken = positions;
+        broken[positions.size() / 2][1] = bad;
+        const auto reply = EnergyClient(socket_path).energy(broken, box_size);
+        std::cout << "Coordinate " << bad << ": status " << reply.status << "\n";
+        ok = ok && reply.status == 4;
+    }
+    const auto reply = EnergyClient(socket_path).energy(positions, box_size);
+    std::cout << "Valid request afterwards: status " << reply.status << ", energy " << reply.energy
+              << " (first " << expected << ")\n";
+    ok = ok && reply.status == 0 && reply.energy == expected;
+    std::cout << (ok ? "PASS" : "FAIL") << "\n";
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+    try
+    {
+        if (mode == "serve" && argc == 3)
+            return serve(argv[2]);
+        if (mode == "stop" && argc == 3)
+        {
+            EnergyClient(argv[2]).shutdown();
+            return 0;
+        }
+        if (mode == "check" && argc == 5)
+            return check(argv[2], std::atof(argv[3]), argv[4]);
+        if (mode == "bench" && argc >= 5)
+        {
+            long calls = 1000;
+            bool with_forces = false, use_shm = false;
+            for (int k = 5; k < argc; k++)
+            {
+                const std::string arg = argv[k];
+                if (arg == "--forces")
+                    with_forces = true;
+                else if (arg == "--shm")
+                    use_shm = true;
+                else
+                    calls = std::atol(argv[k]);
+            }
+            return bench(argv[2], std::atof(argv[3]), argv[4], std::max(calls, 1L), with_forces, use_shm);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "Usage: " << argv[0] << " serve <socket>\n"
+              << "       " << argv[0] << " bench <socket> <box_size> <positions_file> [<calls>] [--forces] [--shm]\n"
+              << "       " << argv[0] << " check <socket> <box_size> <positions_file>\n"
+              << "       " << argv[0] << " stop <socket>\n";
+    return 1;
+}
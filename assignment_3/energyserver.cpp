@@ -0,0 +1,377 @@
+#include "energyserver.h"
+#include "forces.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace energy_protocol;
+
+namespace
+{
+// False on EOF before the first byte; throws on errors and short reads.
+bool read_all(int fd, void *data, std::size_t bytes)
+{
+    char *p = static_cast<char *>(data);
+    std::size_t done = 0;
+    while (done < bytes)
+    {
+        const ssize_t r = ::read(fd, p + done, bytes - done);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            throw std::runtime_error(std::string("read: ") + std::strerror(errno));
+        if (r == 0)
+        {
+            if (done == 0)
+                return false;
+            throw std::runtime_error("connection closed mid-message");
+        }
+        done += r;
+    }
+    return true;
+}
+
+void write_all(int fd, const void *data, std::size_t bytes)
+{
+    const char *p = static_cast<const char *>(data);
+    std::size_t done = 0;
+    while (done < bytes)
+    {
+        const ssize_t w = ::send(fd, p + done, bytes - done, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w < 0)
+            throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+        done += w;
+    }
+}
+
+// NaN or inf would reach the cell binning as an undefined int conversion.
+bool all_finite(const double *xyz, std::uint64_t n)
+{
+    const long count = static_cast<long>(3 * n);
+    int bad = 0;
+#pragma omp parallel for reduction(| : bad) schedule(static)
+    for (long k = 0; k < count; k++)
+        bad |= !std::isfinite(xyz[k]);
+    return bad == 0;
+}
+
+sockaddr_un socket_address(const std::string &path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("socket path too long: " + path);
+    std::strcpy(addr.sun_path, path.c_str());
+    return addr;
+}
+} // namespace
+
+EnergyServer::EnergyServer(const std::string &socket_path, double skin)
+    : path(socket_path), skin(skin)
+{
+    const sockaddr_un addr = socket_address(path);
+    listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    ::unlink(path.c_str());
+    if (::bind(listen_fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listen_fd, 4) < 0)
+    {
+        const std::string err = std::strerror(errno);
+        ::close(listen_fd);
+        throw std::runtime_error("cannot listen on " + path + ": " + err);
+    }
+}
+
+EnergyServer::~EnergyServer()
+{
+    if (shm_base)
+        ::munmap(shm_base, shm_bytes);
+    if (listen_fd >= 0)
+    {
+        ::close(listen_fd);
+        ::unlink(path.c_str());
+    }
+}
+
+const ServerStats &EnergyServer::stats() const
+{
+    return counters;
+}
+
+void EnergyServer::serve()
+{
+    bool running = true;
+    while (running)
+    {
+        const int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("accept: ") + std::strerror(errno));
+        }
+        // A client that stalls mid-request, or idles, would block every other
+        // client; the read then fails and the connection is dropped.
+        const timeval timeout{read_timeout_s, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        try
+        {
+            running = handle(fd);
+        }
+        catch (const std::exception &)
+        {
+            // A broken client only loses its own connection
+        }
+        ::close(fd);
+    }
+}
+
+bool EnergyServer::handle(int fd)
+{
+    RequestHeader req;
+    std::vector<double> payload, out;
+    while (read_all(fd, &req, sizeof(req)))
+    {
+        ReplyHeader reply{magic, 0, req.n, 0.0, 0.0, 0, 0};
+        if (req.magic != magic)
+        {
+            reply.status = 1;
+            write_all(fd, &reply, sizeof(reply));
+            return true; // out of sync, drop the connection
+        }
+        if (req.op == OpShutdown)
+        {
+            write_all(fd, &reply, sizeof(reply));
+            return false;
+        }
+
+        const bool shm = req.op == OpShmEnergy || req.op == OpShmForces;
+        const bool want_forces = req.op == OpForces || req.op == OpShmForces;
+        if (!shm && req.op != OpEnergy && req.op != OpForces)
+        {
+            reply.status = 2;
+            write_all(fd, &reply, sizeof(reply));
+            return true;
+        }
+        // Checked before allocating: n bounds every payload size below
+        if (req.n == 0 || req.n > max_atoms || !(req.box_size >= 5.0 && req.box_size <= max_box_size))
+        {
+            reply.status = 4;
+            write_all(fd, &reply, sizeof(reply));
+            return true;
+        }
+        const double *xyz = nullptr;
+        std::string name;
+        if (shm)
+        {
+            std::uint32_t len = 0;
+            read_all(fd, &len, sizeof(len));
+            if (len == 0 || len > max_name_length)
+            {
+                reply.status = 4;
+                write_all(fd, &reply, sizeof(reply));
+                return true;
+            }
+            name.resize(len);
+            read_all(fd, name.data(), len);
+        }
+        else
+        {
+            payload.resize(3 * req.n);
+            read_all(fd, payload.data(), payload.size() * sizeof(double));
+            xyz = payload.data();
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        double *force_out = nullptr;
+        try
+        {
+            if (shm)
+            {
+                xyz = map_shm(name, req.n, want_forces);
+                if (want_forces)
+                    force_out = const_cast<double *>(xyz) + 3 * req.n;
+            }
+            else if (want_forces)
+            {
+                out.resize(3 * req.n);
+                force_out = out.data();
+            }
+            if (!all_finite(xyz, req.n))
+            {
+                reply.status = 4;
+                write_all(fd, &reply, sizeof(reply));
+                return true;
+            }
+            bool reused = false;
+            reply.energy = evaluate(xyz, req.n, req.box_size, force_out, reused);
+            reply.list_reused = reused;
+        }
+        catch (const std::exception &)
+        {
+            // Including allocation failures: the server stays up
+            reply.status = 3;
+        }
+        reply.ms_compute = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        counters.requests++;
+
+        write_all(fd, &reply, sizeof(reply));
+        if (reply.status == 0 && req.op == OpForces)
+            write_all(fd, out.data(), out.size() * sizeof(double));
+    }
+    return true;
+}
+
+const double *EnergyServer::map_shm(const std::string &name, std::uint64_t n, bool with_forces)
+{
+    if (n > max_atoms)
+        throw std::runtime_error("too many atoms for a shared-memory request");
+    const std::size_t needed = (with_forces ? 6 : 3) * n * sizeof(double);
+    if (shm_base && name == shm_name && shm_bytes >= needed)
+        return static_cast<const double *>(shm_base);
+
+    if (shm_base)
+        ::munmap(shm_base, shm_bytes);
+    shm_base = nullptr;
+    shm_name.clear();
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        throw std::runtime_error("shm_open failed: " + name);
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < needed)
+    {
+        ::close(fd);
+        throw std::runtime_error("shared memory segment too small: " + name);
+    }
+    void *base = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        throw std::runtime_error("mmap failed: " + name);
+    shm_base = base;
+    shm_bytes = st.st_size;
+    shm_name = name;
+    return static_cast<const double *>(shm_base);
+}
+
+double EnergyServer::evaluate(const double *xyz, std::uint64_t n, double box_size, double *out, bool &reused)
+{
+    const long count = static_cast<long>(n);
+    const bool same_shape = system && list && system->get_box_size() == box_size &&
+                            system->get_molecules().size() == n;
+    if (!same_shape)
+    {
+        // Nothing stale survives if the rebuild below throws
+        list.reset();
+        system.reset();
+        system = std::make_unique<MolecularSystem>(box_size);
+        system->reserve(n);
+        for (long i = 0; i < count; i++)
+            system->add_molecule(Molecule(static_cast<int>(i), 0.0, 0.0, 0.0));
+        // The list's minimum image needs cutoff + skin below half the box
+        list = std::make_unique<NeighborList>(box_size, 2.5, std::clamp(0.5 * box_size - 2.5, 0.0, skin));
+    }
+
+    // In place, wrapped: the list and the force kernel assume wrapped positions
+    auto &molecules = system->get_molecules();
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < count; i++)
+    {
+        auto &x = molecules[i].get_coordinates();
+        for (int d = 0; d < 3; d++)
+            x[d] = xyz[3 * i + d] - box_size * std::floor(xyz[3 * i + d] / box_size);
+    }
+
+    reused = same_shape && !list->needs_rebuild(molecules);
+    if (reused)
+    {
+        counters.list_reuses++;
+    }
+    else
+    {
+        list->build(molecules);
+        counters.list_builds++;
+    }
+
+    const double energy = lj_forces(molecules, box_size, *list, ForceRange::Full, ForceSplit{2.5, 2.5}, forces);
+    if (out)
+    {
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < count; i++)
+        {
+            for (int d = 0; d < 3; d++)
+                out[3 * i + d] = forces[i][d];
+        }
+    }
+    return energy;
+}
+
+EnergyClient::EnergyClient(const std::string &socket_path)
+{
+    const sockaddr_un addr = socket_address(socket_path);
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        const std::string err = std::strerror(errno);
+        if (fd >= 0)
+            ::close(fd);
+        throw std::runtime_error("cannot connect to " + socket_path + ": " + err);
+    }
+}
+
+EnergyClient::~EnergyClient()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+ReplyHeader EnergyClient::energy(const std::vector<std::array<double, 3>> &positions, double box_size,
+                                 std::vector<std::array<double, 3>> *forces)
+{
+    const RequestHeader req{magic, forces ? OpForces : OpEnergy, positions.size(), box_size};
+    write_all(fd, &req, sizeof(req));
+    // std::array<double, 3> has no padding, so the vector is the payload
+    write_all(fd, positions.data(), positions.size() * sizeof(positions[0]));
+    ReplyHeader reply;
+    if (!read_all(fd, &reply, sizeof(reply)))
+        throw std::runtime_error("server closed the connection");
+    if (reply.status == 0 && forces)
+    {
+        forces->resize(positions.size());
+        read_all(fd, forces->data(), forces->size() * sizeof((*forces)[0]));
+    }
+    return reply;
+}
+
+ReplyHeader EnergyClient::energy_shm(const std::string &name, std::uint64_t n, double box_size, bool forces)
+{
+    const RequestHeader req{magic, forces ? OpShmForces : OpShmEnergy, n, box_size};
+    const std::uint32_t len = static_cast<std::uint32_t>(name.size());
+    write_all(fd, &req, sizeof(req));
+    write_all(fd, &len, sizeof(len));
+    write_all(fd, name.data(), len);
+    ReplyHeader reply;
+    if (!read_all(fd, &reply, sizeof(reply)))
+        throw std::runtime_error("server closed the connection");
+    return reply;
+}
+
+void EnergyClient::shutdown()
+{
+    const RequestHeader req{magic, OpShutdown, 0, 0.0};
+    write_all(fd, &req, sizeof(req));
+    ReplyHeader reply;
+    read_all(fd, &reply, sizeof(reply));
+}
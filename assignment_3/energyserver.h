@@ -0,0 +1,131 @@
+// energyserver.h
+#ifndef ENERGYSERVER_H
+#define ENERGYSERVER_H
+
+#include "molecularsystem.h"
+#include "neighborlist.h"
+#include "numa.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary protocol over a Unix domain socket, native byte order (client and
+// server share the machine). Every request is a RequestHeader followed by
+//   n * 3 doubles (x y z per atom)            for OpEnergy / OpForces,
+//   a uint32 length and a shm_open() name     for OpShmEnergy / OpShmForces.
+// A shared-memory segment holds n * 3 position doubles, followed by n * 3
+// doubles the server overwrites with forces for OpShmForces. Every request
+// gets a ReplyHeader, for OpForces followed by n * 3 force doubles.
+// Connections are served one after another; a client may send any number
+// of requests on one connection, but one that sends nothing for
+// read_timeout_s seconds (idle or stalled mid-request) is disconnected so
+// the next client gets its turn.
+namespace energy_protocol
+{
+constexpr std::uint32_t magic = 0x4d4f4c53; // "MOLS"
+// Requests outside these limits are rejected before any payload is read.
+constexpr std::uint64_t max_atoms = std::uint64_t(1) << 28;
+constexpr double max_box_size = 1000.0;
+constexpr std::uint32_t max_name_length = 255;
+constexpr long read_timeout_s = 10;
+
+enum Op : std::uint32_t
+{
+    OpEnergy = 1,
+    OpForces = 2,
+    OpShmEnergy = 3,
+    OpShmForces = 4,
+    OpShutdown = 5
+};
+
+struct RequestHeader
+{
+    std::uint32_t magic;
+    std::uint32_t op;
+    std::uint64_t n;
+    double box_size;
+};
+
+struct ReplyHeader
+{
+    std::uint32_t magic;
+    // 0 ok; 1 bad magic, 2 unknown op, 4 n, box or name out of range or a
+    // coordinate not finite (the connection is dropped after these);
+    // 3 evaluation failed
+    std::int32_t status;
+    std::uint64_t n;
+    double energy;
+    double ms_compute; // server time for this request, payload excluded
+    std::uint32_t list_reused; // 1 if the neighbour list of the last call was still valid
+    std::uint32_t reserved;
+};
+} // namespace energy_protocol
+
+struct ServerStats
+{
+    long requests = 0;
+    long list_builds = 0;
+    long list_reuses = 0;
+};
+
+// Keeps a MolecularSystem, a Verlet list and the force buffer alive between
+// requests. Consecutive configurations of the same size and box (frames of
+// one trajectory, optimizer steps) update the molecules in place and reuse
+// the list until some atom has moved more than half the skin. The OpenMP
+// team is created on the first request and stays up.
+class EnergyServer
+{
+public:
+    explicit EnergyServer(const std::string &socket_path, double skin = 0.3);
+    ~EnergyServer();
+    EnergyServer(const EnergyServer &) = delete;
+    EnergyServer &operator=(const EnergyServer &) = delete;
+
+    // Accepts connections until a client sends OpShutdown.
+    void serve();
+    const ServerStats &stats() const;
+
+private:
+    // False once the client asked for shutdown.
+    bool handle(int fd);
+    // Shifted LJ energy; forces are written to out if it is not null.
+    double evaluate(const double *xyz, std::uint64_t n, double box_size, double *out, bool &reused);
+    const double *map_shm(const std::string &name, std::uint64_t n, bool forces);
+
+    std::string path;
+    double skin;
+    int listen_fd = -1;
+    std::unique_ptr<MolecularSystem> system;
+    std::unique_ptr<NeighborList> list;
+    numa_vector<std::array<double, 3>> forces;
+    // Last mapped segment, kept while clients keep sending the same name.
+    std::string shm_name;
+    void *shm_base = nullptr;
+    std::size_t shm_bytes = 0;
+    ServerStats counters;
+};
+
+// Client side; one connection, requests are synchronous.
+class EnergyClient
+{
+public:
+    explicit EnergyClient(const std::string &socket_path);
+    ~EnergyClient();
+    EnergyClient(const EnergyClient &) = delete;
+    EnergyClient &operator=(const EnergyClient &) = delete;
+
+    // Energy of positions; if forces is not null it is resized and filled.
+    energy_protocol::ReplyHeader energy(const std::vector<std::array<double, 3>> &positions, double box_size,
+                                        std::vector<std::array<double, 3>> *forces = nullptr);
+    // Same from a shared-memory segment (see the protocol above).
+    energy_protocol::ReplyHeader energy_shm(const std::string &name, std::uint64_t n, double box_size,
+                                            bool forces);
+    void shutdown();
+
+private:
+    int fd = -1;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+#include "molecule.h"
+#include "molecularsystem.h"
+#include "spme.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+std::vector<double> readXYZCharges(const std::string &filename);
+
+// Random neutral +1/-1 ions, no two closer than 0.9
+static MolecularSystem random_ions(double box_size, int n, unsigned long seed)
+{
+    MolecularSystem system(box_size);
+    system.reserve(n);
+    std::mt19937_64 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, box_size);
+    std::vector<std::array<double, 3>> placed;
+    for (long attempt = 0; static_cast<int>(placed.size()) < n && attempt < 1000L * n; attempt++)
+    {
+        const std::array<double, 3> x{uniform(gen), uniform(gen), uniform(gen)};
+        bool clear = true;
+        for (const auto &y : placed)
+        {
+            double r2 = 0.0;
+            for (int d = 0; d < 3; d++)
+            {
+                double dx = x[d] - y[d];
+                dx -= box_size * std::round(dx / box_size);
+                r2 += dx * dx;
+            }
+            clear = clear && r2 > 0.81;
+        }
+        if (!clear)
+            continue;
+        Molecule mol(static_cast<int>(placed.size()), x[0], x[1], x[2]);
+        mol.set_charge(placed.size() % 2 ? -1.0 : 1.0);
+        system.add_molecule(mol);
+        placed.push_back(x);
+    }
+    return system;
+}
+
+static double rms(const numa_vector<std::array<double, 3>> &a)
+{
+    double s = 0.0;
+    for (const auto &f : a)
+        s += f[0] * f[0] + f[1] * f[1] + f[2] * f[2];
+    return std::sqrt(s / std::max<std::size_t>(1, a.size()));
+}
+
+static void report(const EwaldEnergy &e)
+{
+    std::cout << "LJ " << e.lj << ", Coulomb real " << e.real << ", reciprocal " << e.reciprocal
+              << ", self " << e.self << "\n"
+              << "alpha " << e.alpha << ", mesh " << e.grid << "^3; pair pass " << e.pair_ms
+              << " ms, mesh " << e.mesh_ms << " ms\n";
+}
+
+// Regression against direct Ewald sums on a small random ionic box.
+static int check(double box_size, int n, const EwaldOptions &options, unsigned long seed)
+{
+    MolecularSystem system = random_ions(box_size, n, seed);
+    const auto &molecules = system.get_molecules();
+    std::cout << "N = " << molecules.size() << " ions, box " << box_size << ", tolerance "
+              << options.tolerance << ", order " << options.order << "\n";
+
+    EwaldEnergy parts;
+    const double total = system.total_potential_energy_SPME(options, &parts);
+    report(parts);
+
+    // 1. SPME against the exact reciprocal sum at the same alpha
+    SPME spme(box_size, options);
+    numa_vector<std::array<double, 3>> f_mesh, f_direct;
+    const double e_mesh = spme.reciprocal(molecules, &f_mesh);
+    const double dk = 2.0 * M_PI / box_size;
+    const int n_max = static_cast<int>(std::ceil(2.0 * spme.alpha() * std::sqrt(36.8) / dk));
+    const double e_direct = ewald_reciprocal_direct(molecules, box_size, spme.alpha(), n_max, &f_direct);
+    numa_vector<std::array<double, 3>> diff(f_mesh.size());
+    for (std::size_t j = 0; j < diff.size(); j++)
+        for (int d = 0; d < 3; d++)
+            diff[j][d] = f_mesh[j][d] - f_direct[j][d];
+    const double recip_energy_error = std::abs(e_mesh - e_direct) / std::abs(e_direct);
+    const double recip_force_error = rms(diff) / rms(f_direct);
+    std::cout << "Reciprocal: SPME " << e_mesh << ", direct " << e_direct << " (|n| <= " << n_max
+              << "): energy error " << recip_energy_error << ", RMS force error " << recip_force_error << "\n";
+
+    // 2. Total Coulomb energy against a converged Ewald sum (real space to
+    //    half the box at tolerance 1e-12)
+    const double rc_ref = 0.5 * box_size;
+    const double alpha_ref = ewald_alpha(rc_ref, 1e-12);
+    const int n_ref = static_cast<int>(std::ceil(2.0 * alpha_ref * std::sqrt(36.8) / dk));
+    SPME self_ref(box_size, EwaldOptions{1e-12, rc_ref, options.order, 0});
+    const double coulomb_ref = ewald_real_direct(molecules, box_size, alpha_ref, rc_ref) +
+                               ewald_reciprocal_direct(molecules, box_size, alpha_ref, n_ref) +
+                               self_ref.self_energy(molecules);
+    // Relative to the size of the parts; their sum largely cancels
+    const double coulomb = parts.real + parts.reciprocal + parts.self;
+    const double coulomb_error = std::abs(coulomb - coulomb_ref) /
+                                 (std::abs(parts.real) + std::abs(parts.reciprocal) + std::abs(parts.self));
+    std::cout << "Coulomb: " << coulomb << ", converged Ewald " << coulomb_ref << ": relative error "
+              << coulomb_error << "\n";
+
+    // 3. The fused pass against the separate LJ and real-space sums
+    const double lj_error = std::abs(parts.lj - system.total_potential_energy_LinkedCells());
+    const double real_error = std::abs(parts.real - ewald_real_direct(molecules, box_size, parts.alpha, options.real_cutoff));
+    std::cout << "Fused pass: LJ off by " << lj_error << ", real space off by " << real_error
+              << "; total " << total << "\n";
+
+    const bool ok = recip_energy_error < 10 * options.tolerance && recip_force_error < 100 * options.tolerance &&
+                    coulomb_error < options.tolerance && lj_error < 1e-8 && real_error < 1e-8;
+    std::cout << (ok ? "PASS" : "FAIL") << "\n";
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    EwaldOptions options;
+    unsigned long seed = 1;
+    for (int k = 1; k < argc; k++)
+    {
+        const std::string arg = argv[k];
+        if (arg == "--tol" && k + 1 < argc)
+            options.tolerance = std::atof(argv[++k]);
+        else if (arg == "--order" && k + 1 < argc)
+            options.order = std::atoi(argv[++k]);
+        else if (arg == "--grid" && k + 1 < argc)
+            options.grid = std::atoi(argv[++k]);
+        else if (arg == "--seed" && k + 1 < argc)
+            seed = std::strtoul(argv[++k], nullptr, 10);
+        else
+            args.push_back(arg);
+    }
+    const std::string mode = args.empty() ? "" : args[0];
+
+    try
+    {
+        if (mode == "check" && args.size() == 3)
+        {
+            pin_threads();
+            return check(std::atof(args[1].c_str()), std::atoi(args[2].c_str()), options, seed);
+        }
+        if (mode == "energy" && args.size() == 3)
+        {
+            const double box_size = std::atof(args[1].c_str());
+            if (box_size < 5.0)
+            {
+                std::cerr << "Error: box_size must be at least 5.\n";
+                return 1;
+            }
+            pin_threads();
+            auto positions = readXYZPositions(box_size, args[2]);
+            auto charges = readXYZCharges(args[2]);
+            if (charges.size() != positions.size())
+            {
+                std::cerr << "Error: could not read a charge per atom.\n";
+                return 1;
+            }
+            MolecularSystem system(box_size);
+            system.reserve(positions.size());
+            for (std::size_t i = 0; i < positions.size(); ++i)
+            {
+                Molecule mol(static_cast<int>(i), positions[i][0], positions[i][1], positions[i][2]);
+                mol.set_charge(charges[i]);
+                system.add_molecule(mol);
+            }
+            EwaldEnergy parts;
+            const double total = system.total_potential_energy_SPME(options, &parts);
+            std::cout << "E_pot = " << total << "\n";
+            report(parts);
+            return 0;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "Usage: " << argv[0] << " energy <box_size> <positions_file> [--tol t] [--order p] [--grid K]\n"
+              << "       " << argv[0] << " check <box_size> <ions> [--tol t] [--order p] [--grid K] [--seed s]\n"
+              << "  Charges are read from a fifth XYZ column.\n";
+    return 1;
+}
@@ -0,0 +1,83 @@
+#include "fft.h"
+#include <cmath>
+#include <stdexcept>
+
+FFT3D::FFT3D(int n) : n(n)
+{
+    if (n < 2 || (n & (n - 1)) != 0)
+        throw std::invalid_argument("FFT size must be a power of two");
+    int bits = 0;
+    while ((1 << bits) < n)
+        bits++;
+    reversed.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        reversed[i] = r;
+    }
+    twiddle.resize(n / 2);
+    for (int k = 0; k < n / 2; k++)
+        twiddle[k] = std::polar(1.0, -2.0 * M_PI * k / n);
+}
+
+int FFT3D::size() const
+{
+    return n;
+}
+
+void FFT3D::line(std::complex<double> *a, int sign) const
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (i < reversed[i])
+            std::swap(a[i], a[reversed[i]]);
+    }
+    for (int len = 2; len <= n; len *= 2)
+    {
+        const int half = len / 2, step = n / len;
+        for (int start = 0; start < n; start += len)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                const std::complex<double> w = sign < 0 ? twiddle[k * step] : std::conj(twiddle[k * step]);
+                const std::complex<double> u = a[start + k], v = a[start + k + half] * w;
+                a[start + k] = u + v;
+                a[start + k + half] = u - v;
+            }
+        }
+    }
+}
+
+void FFT3D::transform(std::vector<std::complex<double>> &grid, int sign) const
+{
+    const long lines = static_cast<long>(n) * n;
+    // x lines are contiguous
+#pragma omp parallel for schedule(static)
+    for (long l = 0; l < lines; l++)
+    {
+        line(&grid[l * n], sign);
+    }
+    // y and z lines via a gathered copy
+    for (int axis = 1; axis <= 2; axis++)
+    {
+        const long stride = axis == 1 ? n : static_cast<long>(n) * n;
+#pragma omp parallel
+        {
+            std::vector<std::complex<double>> buffer(n);
+#pragma omp for schedule(static)
+            for (long l = 0; l < lines; l++)
+            {
+                // l enumerates the two other coordinates
+                const long a = l % n, b = l / n;
+                const long base = axis == 1 ? a + b * static_cast<long>(n) * n : a + b * n;
+                for (int k = 0; k < n; k++)
+                    buffer[k] = grid[base + k * stride];
+                line(buffer.data(), sign);
+                for (int k = 0; k < n; k++)
+                    grid[base + k * stride] = buffer[k];
+            }
+        }
+    }
+}
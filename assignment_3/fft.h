@@ -0,0 +1,28 @@
+// fft.h
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <vector>
+
+// In-place complex FFT on a cubic n x n x n grid, n a power of two, stored
+// with x fastest: index (z * n + y) * n + x. Radix-2, iterative, unscaled in
+// both directions; lines along each axis are transformed in parallel.
+class FFT3D
+{
+public:
+    explicit FFT3D(int n);
+
+    int size() const;
+    // sign -1: sum_k a(k) exp(-2 pi i m.k / n); sign +1: exp(+...)
+    void transform(std::vector<std::complex<double>> &grid, int sign) const;
+
+private:
+    void line(std::complex<double> *a, int sign) const;
+
+    int n;
+    std::vector<int> reversed;
+    std::vector<std::complex<double>> twiddle; // exp(-2 pi i k / n), k < n / 2
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "forces.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// One kernel per range so that the pair filter and the switch are resolved
+// at compile time; the short kernel never touches the outer shell and the
+// long kernel does no switch work for pairs beyond r_hi.
+template <ForceRange R>
+double kernel(const numa_vector<Molecule> &molecules, double box_size, const NeighborList &list,
+              const ForceSplit &split, numa_vector<std::array<double, 3>> &forces)
+{
+    const double rc2 = 2.5 * 2.5;
+    const double ic6 = 1.0 / (rc2 * rc2 * rc2);
+    const double u_cut = 4.0 * (ic6 * ic6 - ic6);
+    const double lo2 = split.r_lo * split.r_lo, hi2 = split.r_hi * split.r_hi;
+    const double inv_width = 1.0 / (split.r_hi - split.r_lo);
+    const double half = 0.5 * box_size;
+    const auto &start = list.start();
+    const auto &nb = list.neighbors();
+    const long n = static_cast<long>(molecules.size());
+    double energy = 0.0;
+
+#pragma omp parallel for reduction(+ : energy) schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        const auto &xi = molecules[i].get_coordinates();
+        double fx = 0.0, fy = 0.0, fz = 0.0, ui = 0.0;
+        // Branch-free: pairs outside the range are masked, not skipped, so
+        // the random mix of in- and out-of-range pairs costs no mispredicts.
+#pragma omp simd reduction(+ : fx, fy, fz, ui)
+        for (std::size_t k = start[i]; k < start[i + 1]; k++)
+        {
+            const auto &xj = molecules[nb[k]].get_coordinates();
+            double dx = xi[0] - xj[0], dy = xi[1] - xj[1], dz = xi[2] - xj[2];
+            // Positions are wrapped at every list build and move less than
+            // a skin before the next, so one select per axis is the minimum
+            // image.
+            dx += dx < -half ? box_size : (dx > half ? -box_size : 0.0);
+            dy += dy < -half ? box_size : (dy > half ? -box_size : 0.0);
+            dz += dz < -half ? box_size : (dz > half ? -box_size : 0.0);
+            const double r2 = dx * dx + dy * dy + dz * dz;
+            const bool keep = (r2 < (R == ForceRange::Short ? hi2 : rc2)) &
+                              (r2 >= (R == ForceRange::Long ? lo2 : 1e-12));
+            double inv_r2, r = 0.0, inv_r = 0.0;
+            if (R == ForceRange::Full)
+            {
+                inv_r2 = 1.0 / (keep ? r2 : 1.0);
+            }
+            else
+            {
+                // The switch needs r; one sqrt and one division serve both
+                r = std::sqrt(keep ? r2 : 1.0);
+                inv_r = 1.0 / r;
+                inv_r2 = inv_r * inv_r;
+            }
+            const double inv_r6 = inv_r2 * inv_r2 * inv_r2;
+            const double u = keep ? 4.0 * (inv_r6 * inv_r6 - inv_r6) - u_cut : 0.0;
+            // -du/dr divided by r
+            double f_over_r = keep ? 24.0 * (2.0 * inv_r6 * inv_r6 - inv_r6) * inv_r2 : 0.0;
+            double share = u;
+            if (R != ForceRange::Full)
+            {
+                // x is clamped to [0, 1], where the switch is flat
+                const double x = std::min(1.0, std::max(0.0, (r - split.r_lo) * inv_width));
+                const double sw = 1.0 + x * x * (2.0 * x - 3.0);
+                const double dsw = 6.0 * x * (x - 1.0) * inv_width * inv_r;
+                const double s = R == ForceRange::Short ? sw : 1.0 - sw;
+                const double ds_over_r = R == ForceRange::Short ? dsw : -dsw;
+                f_over_r = s * f_over_r - ds_over_r * u;
+                share = s * u;
+            }
+            fx += f_over_r * dx;
+            fy += f_over_r * dy;
+            fz += f_over_r * dz;
+            ui += share;
+        }
+        forces[i] = {fx, fy, fz};
+        energy += 0.5 * ui;
+    }
+    return energy;
+}
+} // namespace
+
+double lj_forces(const numa_vector<Molecule> &molecules, double box_size, const NeighborList &list,
+                 ForceRange range, const ForceSplit &split, numa_vector<std::array<double, 3>> &forces)
+{
+    forces.resize(molecules.size());
+    switch (range)
+    {
+    case ForceRange::Short:
+        return kernel<ForceRange::Short>(molecules, box_size, list, split, forces);
+    case ForceRange::Long:
+        return kernel<ForceRange::Long>(molecules, box_size, list, split, forces);
+    default:
+        return kernel<ForceRange::Full>(molecules, box_size, list, split, forces);
+    }
+}
@@ -0,0 +1,33 @@
+// forces.h
+#ifndef FORCES_H
+#define FORCES_H
+
+#include "molecule.h"
+#include "neighborlist.h"
+#include "numa.h"
+#include <array>
+
+// Range of the shifted LJ interaction a force evaluation covers. For
+// multiple time stepping the pair potential is split smoothly,
+//   u = S(r) u + (1 - S(r)) u,
+// with S = 1 below r_lo, 0 above r_hi and a cubic in between, so that both
+// parts and their forces are continuous.
+enum class ForceRange
+{
+    Full,
+    Short, // S(r) u, pairs below r_hi only
+    Long   // (1 - S(r)) u, pairs from r_lo to the cutoff only
+};
+
+struct ForceSplit
+{
+    double r_lo, r_hi;
+};
+
+// Forces (overwritten) and potential energy of one range, for unit mass LJ
+// particles with the 2.5 sigma cutoff. The list must cover the range: the
+// short range only needs pairs within r_hi.
+double lj_forces(const numa_vector<Molecule> &molecules, double box_size, const NeighborList &list,
+                 ForceRange range, const ForceSplit &split, numa_vector<std::array<double, 3>> &forces);
+
+#endif
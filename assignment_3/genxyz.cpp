@@ -4,12 +4,17 @@
 #include <cstdlib>
 #include <ctime>
 #include <string>
+#include <vector>
+#include <array>
+#include "molecularsystem.h"
+#include "minimizer.h"
 
 int main(int argc, char *argv[])
 {
-    if (argc < 4)
+    const bool relax = argc == 5 && std::string(argv[4]) == "--relax";
+    if (argc < 4 || (argc > 4 && !relax))
     {
-        std::cerr << "Usage: " << argv[0] << " <boxSize> <density> <out.xyz>\n";
+        std::cerr << "Usage: " << argv[0] << " <boxSize> <density> <out.xyz> [--relax]\n";
         return 1;
     }
     double boxSize = std::atof(argv[1]);
@@ -36,8 +41,8 @@ int main(int argc, char *argv[])
     double spacing = boxSize / double(nCbrt);
     double jitter = 0.2 * spacing;
 
-    std::ofstream ofs(outFile);
-    ofs << N << "\n\n";
+    std::vector<std::array<double, 3>> positions;
+    positions.reserve(N);
     int count = 0;
     for (int ix = 0; ix < nCbrt && count < N; ix++)
     {
@@ -63,97 +68,41 @@ int main(int argc, char *argv[])
                     z += boxSize;
                 else if (z >= boxSize)
                     z -= boxSize;
-                ofs << "C " << x << " " << y << " " << z << "\n";
+                positions.push_back({x, y, z});
                 count++;
             }
         }
-      
-int genxyz(int box_size, float density, const std::string &filename)
-{
-    // Calculate desired total number of atoms
-    int N = static_cast<int>(std::round(box_size * box_size * box_size * density));
-
-    // Jitter factor / spacing factor
-    float jitter_factor = 0.2f;
-    int min_size = 5; // if fewer than min_size, bail out
-
-    // If N < min_size, we won't create the file
-    if (N < min_size)
-    {
-        std::cerr << "Error: N (" << N
-                  << ") is smaller than min_size (" << min_size
-                  << "). No file created.\n";
-        return 1;
-    }
-
-    // Figure out an integer nCbrt so nCbrt^3 >= N
-    int nCbrt = static_cast<int>(std::cbrt(N));
-    while (nCbrt * nCbrt * nCbrt < N)
-    {
-        nCbrt++;
     }
 
-    // Calculate spacing so that nCbrt points span 'box_size'
-    double spacing = static_cast<double>(box_size) / nCbrt;
-
-    // Open file
-    std::ofstream file(filename);
-    if (!file.is_open())
-    {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return 1;
-    }
-
-    // Write header: number of atoms + blank line
-    file << N << std::endl;
-    file << std::endl;
-
-    // Place exactly N atoms on this smaller 3D grid
-    int count = 0;
-    for (int i = 0; i < nCbrt && count < N; i++)
+    // Jittered lattice sites can overlap; relax them away in place.
+    if (relax)
     {
-        for (int j = 0; j < nCbrt && count < N; j++)
+        MolecularSystem system(boxSize);
+        system.reserve(positions.size());
+        for (std::size_t i = 0; i < positions.size(); i++)
+            system.add_molecule(Molecule(static_cast<int>(i), positions[i][0], positions[i][1], positions[i][2]));
+        MinimizeOptions options;
+        // A pair at 1 sigma already pushes with 24, so below 10 the overlaps
+        // are gone; MD takes it from here
+        options.force_tol = 10.0;
+        MinimizeResult r = FireMinimizer(system, options).run();
+        std::cerr << "Relaxed " << positions.size() << " atoms: E_pot = " << r.energy
+                  << ", max force " << r.max_force << ", " << r.iterations << " iterations ("
+                  << r.sd_iterations << " steepest descent), " << r.rebuilds << " list builds, "
+                  << r.ms << " ms" << (r.converged ? "" : " (not converged)") << ".\n";
+        const auto &molecules = system.get_molecules();
+        for (std::size_t i = 0; i < positions.size(); i++)
         {
-            for (int k = 0; k < nCbrt && count < N; k++)
-            {
-                // center of each cell
-                double x = (i + 0.5) * spacing;
-                double y = (j + 0.5) * spacing;
-                double z = (k + 0.5) * spacing;
-
-                // add random jitter (± jitter_factor * spacing)
-                x += (2.0 * (double(rand()) / RAND_MAX) - 1.0) * jitter_factor * spacing;
-                y += (2.0 * (double(rand()) / RAND_MAX) - 1.0) * jitter_factor * spacing;
-                z += (2.0 * (double(rand()) / RAND_MAX) - 1.0) * jitter_factor * spacing;
-
-                // wrap using periodic boundary conditions
-                x = std::fmod(x + box_size, box_size);
-                y = std::fmod(y + box_size, box_size);
-                z = std::fmod(z + box_size, box_size);
-
-                // output: "C x y z"
-                file << "C " << x << " " << y << " " << z << std::endl;
-
-                ++count; // one more atom placed
-            }
+            positions[i] = molecules[i].get_coordinates();
+            for (double &x : positions[i])
+                x -= boxSize * std::floor(x / boxSize);
         }
     }
 
-    file.close();
-    return 0;
-}
-
-int main(int argc, char *argv[])
-{
-    // seed random for jitter
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
-
-    if (argc < 4)
-    {
-        std::cerr << "Usage: " << argv[0]
-                  << " <box_size> <density> <output_filename>\n";
-        return 1;
-    }
+    std::ofstream ofs(outFile);
+    ofs << N << "\n\n";
+    for (const auto &p : positions)
+        ofs << "C " << p[0] << " " << p[1] << " " << p[2] << "\n";
     ofs.close();
     return 0;
 }
@@ -0,0 +1,213 @@
+#include "halogrid.h"
+#include "molecularsystem.h"
+#include "partition.h"
+#include "reduction.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <omp.h>
+#include <vector>
+
+HaloGrid::HaloGrid(const CellGrid &grid)
+    : n_side(grid.cells_per_side()), p_side(grid.cells_per_side() + 2), n_halo(0)
+{
+    const double box_size = grid.cell_size() * n_side;
+    const int n_padded = p_side * p_side * p_side;
+    const auto &src_start = grid.cell_start();
+    const auto &src_pos = grid.positions();
+
+    // Every padded cell copies one source cell: itself for the interior,
+    // the periodic partner across the box for the halo.
+    auto source = [&](int p, std::array<double, 3> &shift)
+    {
+        int c[3] = {p % p_side, (p / p_side) % p_side, p / (p_side * p_side)};
+        for (int d = 0; d < 3; d++)
+        {
+            shift[d] = c[d] == 0 ? -box_size : (c[d] == p_side - 1 ? box_size : 0.0);
+            c[d] = (c[d] - 1 + n_side) % n_side;
+        }
+        return c[0] + c[1] * n_side + c[2] * n_side * n_side;
+    };
+
+    // The forward half stencil never looks towards low x, and only reaches
+    // some of the edge and corner cells; halo cells it misses stay empty.
+    const int n_cells = grid.num_cells();
+    stencil.resize(n_cells);
+    std::vector<char> reached(n_padded, 0);
+    for (int c = 0; c < n_cells; c++)
+    {
+        const int p = padded_cell(c);
+        reached[p] = 1;
+        for (int n = 0; n < CellGrid::half_stencil_size; n++)
+        {
+            const int *o = CellGrid::stencil_offsets[n];
+            stencil[c][n] = p + o[0] + o[1] * p_side + o[2] * p_side * p_side;
+            reached[stencil[c][n]] = 1;
+        }
+    }
+
+    starts.assign(n_padded + 1, 0);
+    std::array<double, 3> shift;
+    for (int p = 0; p < n_padded; p++)
+    {
+        const int c = source(p, shift);
+        const std::size_t count = reached[p] ? src_start[c + 1] - src_start[c] : 0;
+        starts[p + 1] = starts[p] + count;
+        if (is_halo(p))
+        {
+            n_halo += count;
+        }
+    }
+    padded_positions.resize(starts[n_padded]);
+
+#pragma omp parallel for schedule(static)
+    for (int p = 0; p < n_padded; p++)
+    {
+        if (!reached[p])
+        {
+            continue;
+        }
+        std::array<double, 3> s;
+        const int c = source(p, s);
+        std::size_t out = starts[p];
+        for (std::size_t k = src_start[c]; k < src_start[c + 1]; k++)
+        {
+            std::array<double, 3> x = src_pos[k];
+            for (int d = 0; d < 3; d++)
+            {
+                // Wrap into the box, then move to this cell's image
+                x[d] -= box_size * std::floor(x[d] / box_size);
+                x[d] += s[d];
+            }
+            padded_positions[out++] = x;
+        }
+    }
+}
+
+int HaloGrid::padded_side() const
+{
+    return p_side;
+}
+
+int HaloGrid::padded_cell(int c) const
+{
+    const int cx = c % n_side, cy = (c / n_side) % n_side, cz = c / (n_side * n_side);
+    return (cx + 1) + (cy + 1) * p_side + (cz + 1) * p_side * p_side;
+}
+
+bool HaloGrid::is_halo(int padded) const
+{
+    const int c[3] = {padded % p_side, (padded / p_side) % p_side, padded / (p_side * p_side)};
+    for (int d = 0; d < 3; d++)
+    {
+        if (c[d] == 0 || c[d] == p_side - 1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t HaloGrid::halo_particles() const
+{
+    return n_halo;
+}
+
+const numa_vector<std::size_t> &HaloGrid::cell_start() const
+{
+    return starts;
+}
+
+const numa_vector<std::array<double, 3>> &HaloGrid::positions() const
+{
+    return padded_positions;
+}
+
+const std::array<int, CellGrid::half_stencil_size> &HaloGrid::half_stencil(int c) const
+{
+    return stencil[c];
+}
+
+// MolecularSystem backend; defined here so that only binaries using it link
+// the halo grid.
+double MolecularSystem::total_potential_energy_HaloCells(HaloStats *stats) const
+{
+    const double cell_size = 2.5;
+    CellGrid grid(box_size, cell_size);
+    if (grid.cells_per_side() < 3)
+    {
+        return total_potential_energy_SmallBox();
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    grid.build(molecules);
+    auto t1 = std::chrono::steady_clock::now();
+    const HaloGrid halo(grid);
+    auto t2 = std::chrono::steady_clock::now();
+
+    const auto &grid_start = grid.cell_start();
+    const auto &cell_start = halo.cell_start();
+    const auto &pos = halo.positions();
+    const std::vector<CellChunk> chunks = partition_cells(grid, 8 * omp_get_max_threads());
+    const int num_chunks = static_cast<int>(chunks.size());
+    double potential_energy = 0.0;
+    double interior_pairs = 0.0, halo_pairs = 0.0;
+    // Reproducible mode: one partial sum per slot of the source grid
+    numa_vector<double> rows(reproducible_sums ? grid.positions().size() : 0);
+
+#pragma omp parallel for reduction(+ : potential_energy, interior_pairs, halo_pairs) schedule(static)
+    for (int k = 0; k < num_chunks; k++)
+    {
+        const CellChunk &chunk = chunks[k];
+        for (int cell_idx = chunk.cell_begin; cell_idx < chunk.cell_end; cell_idx++)
+        {
+            // Chunk rows are numbered in the source grid; map them over
+            const int p = halo.padded_cell(cell_idx);
+            const size_t first = std::max(grid_start[cell_idx], chunk.slot_begin) - grid_start[cell_idx];
+            const size_t last = std::min(grid_start[cell_idx + 1], chunk.slot_end) - grid_start[cell_idx];
+            const size_t end = cell_start[p + 1];
+            for (size_t i = cell_start[p] + first; i < cell_start[p] + last; i++)
+            {
+                double row = 0.0;
+                interior_pairs += static_cast<double>(end - i - 1);
+                for (size_t j = i + 1; j < end; j++)
+                {
+                    const double dx = pos[i][0] - pos[j][0];
+                    const double dy = pos[i][1] - pos[j][1];
+                    const double dz = pos[i][2] - pos[j][2];
+                    row += lj_energy_r2(dx * dx + dy * dy + dz * dz);
+                }
+                for (int neighbor : halo.half_stencil(cell_idx))
+                {
+                    const size_t n_nb = cell_start[neighbor + 1] - cell_start[neighbor];
+                    (halo.is_halo(neighbor) ? halo_pairs : interior_pairs) += static_cast<double>(n_nb);
+                    for (size_t j = cell_start[neighbor]; j < cell_start[neighbor + 1]; j++)
+                    {
+                        const double dx = pos[i][0] - pos[j][0];
+                        const double dy = pos[i][1] - pos[j][1];
+                        const double dz = pos[i][2] - pos[j][2];
+                        row += lj_energy_r2(dx * dx + dy * dy + dz * dz);
+                    }
+                }
+                if (reproducible_sums)
+                    rows[grid_start[cell_idx] + (i - cell_start[p])] = row;
+                else
+                    potential_energy += row;
+            }
+        }
+    }
+    if (reproducible_sums)
+        potential_energy = reproducible_sum(rows);
+    auto t3 = std::chrono::steady_clock::now();
+
+    if (stats)
+    {
+        stats->halo_particles = halo.halo_particles();
+        stats->interior_pairs = interior_pairs;
+        stats->halo_pairs = halo_pairs;
+        stats->build_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        stats->halo_ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        stats->pair_ms = std::chrono::duration<double, std::milli>(t3 - t2).count();
+    }
+    return potential_energy;
+}
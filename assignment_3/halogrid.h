@@ -0,0 +1,52 @@
+// halogrid.h
+#ifndef HALOGRID_H
+#define HALOGRID_H
+
+#include "cellgrid.h"
+#include "numa.h"
+#include <array>
+#include <cstddef>
+
+// Work split reported by the halo-padded energy evaluation.
+struct HaloStats
+{
+    std::size_t halo_particles = 0;  // periodic image copies
+    double interior_pairs = 0.0;     // distance checks against interior cells
+    double halo_pairs = 0.0;         // distance checks against halo cells
+    double build_ms = 0.0;           // binning the interior grid
+    double halo_ms = 0.0;            // building the padded grid with images
+    double pair_ms = 0.0;            // pair traversal
+};
+
+// Copy of a CellGrid padded with a one-cell halo layer. Halo cells hold the
+// particles of the opposite boundary cells, shifted by one box length, so
+// that neighbours of every interior cell are found without wrapping and all
+// distances are plain Euclidean ones. Only halo cells in some interior
+// cell's half stencil are filled; the rest (the whole low-x face, and edge
+// and corner cells the stencil misses) are kept empty.
+class HaloGrid
+{
+public:
+    explicit HaloGrid(const CellGrid &grid);
+
+    int padded_side() const;
+    // Padded index of interior cell c of the source grid.
+    int padded_cell(int c) const;
+    bool is_halo(int padded) const;
+    std::size_t halo_particles() const;
+
+    const numa_vector<std::size_t> &cell_start() const;
+    const numa_vector<std::array<double, 3>> &positions() const;
+    // Half stencil of interior cell c (source numbering), in padded indices.
+    const std::array<int, CellGrid::half_stencil_size> &half_stencil(int c) const;
+
+private:
+    int n_side;
+    int p_side;
+    std::size_t n_halo;
+    numa_vector<std::size_t> starts;
+    numa_vector<std::array<double, 3>> padded_positions;
+    numa_vector<std::array<int, CellGrid::half_stencil_size>> stencil;
+};
+
+#endif
@@ -4,8 +4,15 @@
 #include <vector>
 #include <cstdlib>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
 #include "molecule.h"
 #include "molecularsystem.h"
+#include "numa.h"
+#include "pipeline.h"
+#include "perfcounters.h"
 
 std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
 
@@ -20,87 +27,100 @@ struct ThresholdResult
           timeDirect(tD), timeLinked(tL) {}
 };
 
-void find_thresholds(const std::string &directory)
-{
-    std::filesystem::path dir(directory);
-    if (!std::filesystem::exists(dir) || !std::filesystem::is_directory(dir))
-#include <sys/stat.h>
-#include <string>
-#include <map>
-#include <vector>
-#include <cstdlib>
-#include <filesystem>
-#include <regex>
-#include <fstream>
-#include <chrono>
-
-#include "molecule.h"
-#include "molecularsystem.h"
-
-// Function to read .xyz files (ensure this matches the declaration in readxyz.h)
-std::vector<std::array<double, 3>> readXYZ(const std::string &filename);
-
-// Structure to store results
-struct ThresholdResult
+// A snapshot parsed by a reader thread, waiting for the compute stage.
+struct ParsedFile
 {
     std::string filename;
-    double box_val;
-    double density_val;
-    size_t numMolecules;
-    double timeDirect;
-    double timeLinked;
-
-    // Constructor
-    ThresholdResult(std::string f, double b, double d, size_t n, double tD, double tL)
-        : filename(std::move(f)), box_val(b), density_val(d), numMolecules(n),
-          timeDirect(tD), timeLinked(tL) {}
+    double box, density;
+    std::vector<std::array<double, 3>> positions;
 };
 
-// Function to find thresholds and process files
-void find_thresholds(const std::string &directory)
+// Readers parse upcoming files while the OpenMP team evaluates the current
+// one. The queue bounds how many parsed snapshots are held in memory.
+const int num_readers = 2;
+const size_t queue_capacity = 4;
+
+void find_thresholds(const std::string &directory, bool use_perf)
 {
-    // Use standard filesystem
-    std::filesystem::path file_path(directory);
-    if (!std::filesystem::exists(file_path) || !std::filesystem::is_directory(file_path))
+    std::filesystem::path dir(directory);
+    if (!std::filesystem::exists(dir) || !std::filesystem::is_directory(dir))
     {
         std::cerr << "Error: " << directory << " not found or not a directory.\n";
         return;
     }
-    std::vector<ThresholdResult> results;
     std::regex pattern("^box([0-9\\.]+)-density([0-9\\.]+)-positions\\.xyz$");
 
+    std::vector<std::filesystem::path> files;
     for (const auto &entry : std::filesystem::directory_iterator(dir))
     {
         if (!std::filesystem::is_regular_file(entry.path()))
             continue;
-
         std::string fname = entry.path().filename().string();
-        std::smatch match;
-
-        if (!std::regex_match(fname, match, pattern))
-            continue;
+        if (std::regex_match(fname, pattern))
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
 
-        double box_val = std::stod(match[1].str());
-        double density_val = std::stod(match[2].str());
-        auto posData = readXYZPositions(box_val, entry.path().string());
+    BoundedQueue<ParsedFile> queue(queue_capacity);
+    std::atomic<size_t> next_file{0};
+    std::atomic<int> readers_left{num_readers};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < num_readers; r++)
+    {
+        readers.emplace_back([&]
+                             {
+            unpin_thread();
+            for (size_t k = next_file++; k < files.size(); k = next_file++)
+            {
+                std::string fname = files[k].filename().string();
+                std::smatch match;
+                std::regex_match(fname, match, pattern);
+                double box_val = std::stod(match[1].str());
+                double density_val = std::stod(match[2].str());
+                queue.push(ParsedFile{fname, box_val, density_val,
+                                      readXYZPositions(box_val, files[k].string())});
+            }
+            if (--readers_left == 0)
+                queue.close(); });
+    }
 
-        MolecularSystem system(box_val);
+    // Compute stage: build on this thread so the OpenMP team does the
+    // first touch, then stream one result record per file.
+    std::vector<ThresholdResult> results;
+    while (auto parsed = queue.pop())
+    {
+        const auto &posData = parsed->positions;
+        MolecularSystem system(parsed->box);
+        system.reserve(posData.size());
         for (size_t i = 0; i < posData.size(); ++i)
             system.add_molecule(Molecule(static_cast<int>(i),
                                          posData[i][0], posData[i][1], posData[i][2],
                                          0.0, 0.0, 0.0));
 
         auto start = std::chrono::high_resolution_clock::now();
-        double E_direct = system.total_potential_energy();
+        [[maybe_unused]] double E_direct = system.total_potential_energy();
         auto end = std::chrono::high_resolution_clock::now();
         double tDirect = std::chrono::duration<double, std::milli>(end - start).count();
+        std::unique_ptr<PerfCounters> perf;
+        if (use_perf)
+            perf = std::make_unique<PerfCounters>();
         start = std::chrono::high_resolution_clock::now();
-        double E_linked = system.total_potential_energy_LinkedCells();
+        [[maybe_unused]] double E_linked = system.total_potential_energy_LinkedCells(perf.get());
         end = std::chrono::high_resolution_clock::now();
         double tLinked = std::chrono::duration<double, std::milli>(end - start).count();
-        results.push_back(ThresholdResult(fname, box_val, density_val,
+
+        std::cout << parsed->filename << ": N = " << posData.size()
+                  << ", direct " << tDirect << " ms, linked " << tLinked << " ms";
+        if (perf && perf->available())
+            std::cout << " (pair loop IPC " << perf->ipc("pairs") << ", "
+                      << perf->bytes_per_pair("pairs") << " LLC bytes/pair)";
+        std::cout << "\n";
+        results.push_back(ThresholdResult(parsed->filename, parsed->box, parsed->density,
                                           system.get_molecules().size(), tDirect, tLinked));
     }
+    for (auto &reader : readers)
+        reader.join();
+
     const ThresholdResult *best = nullptr;
     for (const auto &r : results)
         if (r.timeLinked < r.timeDirect && (!best || r.numMolecules < best->numMolecules))
@@ -111,79 +131,14 @@ void find_thresholds(const std::string &directory)
                   << " (num molecules = " << best->numMolecules << ").\n";
     else
         std::cout << "Linked cells never outperformed direct iteration.\n";
-
-    std::vector<ThresholdResult> results;
-
-    // Regex pattern: e.g. "box20-density0.8-positions.xyz"
-    std::regex pattern("^box([0-9\\.]+)-density([0-9\\.]+)-positions\\.xyz$");
-
-    for (const auto &entry : std::filesystem::directory_iterator(file_path))
-    {
-        if (std::filesystem::is_regular_file(entry.path()))
-        {
-            const std::string filename = entry.path().filename().string();
-            std::smatch match;
-            if (std::regex_match(filename, match, pattern))
-            {
-                // Extract values from filename
-                double box_val = std::stod(match[1].str());
-                double density_val = std::stod(match[2].str());
-
-                // Read .xyz content
-                std::string full_path = entry.path().string();
-                auto posData = readXYZ(full_path);
-
-                // Build MolecularSystem
-                MolecularSystem system(box_val);
-                for (size_t i = 0; i < posData.size(); ++i)
-                {
-                    // Provide all 7 parameters to Molecule
-                    system.addMolecule(Molecule(static_cast<int>(i),
-                                                posData[i][0], posData[i][1], posData[i][2],
-                                                0.0, 0.0, 0.0));
-                }
-
-                // Measure Direct potential energy computation
-                auto start = std::chrono::high_resolution_clock::now();
-                [[maybe_unused]] double E_direct = system.totalPotentialEnergy();
-                auto end = std::chrono::high_resolution_clock::now();
-                double time_direct_ms = std::chrono::duration<double, std::milli>(end - start).count();
-
-                // Measure Linked Cells potential energy computation
-                start = std::chrono::high_resolution_clock::now();
-                [[maybe_unused]] double E_linked = system.totalPotentialEnergyLinkedCells();
-                end = std::chrono::high_resolution_clock::now();
-                double time_linked_ms = std::chrono::duration<double, std::milli>(end - start).count();
-
-                // Use explicit constructor for ThresholdResult
-                results.push_back(ThresholdResult(filename, box_val, density_val,
-                                                  system.getMolecules().size(), time_direct_ms, time_linked_ms));
-            }
-        }
-    }
-
-    // Find smallest threshold where linked cells is faster
-    size_t bestThreshold = std::numeric_limits<size_t>::max();
-    for (const auto &r : results)
-    {
-        if (r.timeLinked < r.timeDirect && r.numMolecules < bestThreshold)
-        {
-            bestThreshold = r.numMolecules;
-        }
-    }
-
-    if (bestThreshold == std::numeric_limits<size_t>::max())
-    {
-        std::cout << "Linked cells never outperformed direct iteration.\n";
-    }
-    else
-    {
-        std::cout << "Use linked cells at number molecules >= " << bestThreshold << "\n";
-    }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    // --perf: report hardware counters for the linked-cell pair loop
+    const bool use_perf = argc > 1 && std::string(argv[1]) == "--perf";
+    pin_threads();
+
     const std::string dir_name = "positions_files";
     if (!std::filesystem::exists(dir_name) && !std::filesystem::create_directory(dir_name))
     {
@@ -205,53 +160,6 @@ int main()
             if (std::system(command.c_str()) != 0)
                 std::cerr << "Error executing: " << command << "\n";
         }
-    find_thresholds(dir_name);
-    return 0;
-}
-    // Create directory if it doesn't exist
-    const char *dir_name = "positions_files";
-    struct stat info;
-    if (stat(dir_name, &info) != 0)
-    {
-        if (mkdir(dir_name, 0777) == -1)
-        {
-            std::cerr << "Error creating directory" << std::endl;
-            return 1;
-        }
-        else
-        {
-            std::cout << "Directory created" << std::endl;
-        }
-    }
-
-    // Define parameters
-    std::map<std::string, std::vector<double>> parameters = {
-        {"a", {6.0, 9.0, 10.0, 12.0, 15.0, 20.0}},
-        {"rho", {0.4, 0.6, 0.8, 1.0, 1.2}}};
-
-    // Generate .xyz files
-    for (double a : parameters["a"])
-    {
-        for (double rho : parameters["rho"])
-        {
-            std::string filename = std::string(dir_name) + "/box" +
-                                   std::to_string(static_cast<int>(a)) + "-density" +
-                                   std::to_string(rho) + "-positions.xyz";
-
-            std::string command = "./genxyz " + std::to_string(a) + " " +
-                                  std::to_string(rho) + " " + filename;
-
-            std::cout << "Executing: " << command << std::endl;
-            int result = std::system(command.c_str());
-            if (result != 0)
-            {
-                std::cerr << "Error executing command: " << command << std::endl;
-            }
-        }
-    }
-
-    // Compute thresholds
-    find_thresholds("positions_files");
-
+    find_thresholds(dir_name, use_perf);
     return 0;
 }
@@ -0,0 +1,158 @@
+#include "integrator.h"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+MDIntegrator::MDIntegrator(MolecularSystem &system, const MDOptions &options)
+    : system(system), opt(options),
+      split{options.inner_cutoff - options.switch_width, options.inner_cutoff},
+      respa(options.respa_steps > 1),
+      outer(system.get_box_size(), 2.5, options.skin),
+      inner(system.get_box_size(), options.inner_cutoff, options.skin),
+      u_short(0.0), u_long(0.0), rng(options.seed)
+{
+    if (opt.respa_steps < 1 || opt.dt <= 0.0)
+        throw std::invalid_argument("respa_steps must be >= 1 and dt positive");
+    if (respa && (split.r_lo <= 0.0 || opt.inner_cutoff > 2.5))
+        throw std::invalid_argument("inner cutoff must exceed the switch width and stay within 2.5");
+
+    update_lists();
+    short_forces();
+    if (respa)
+        long_forces();
+}
+
+double MDIntegrator::potential_energy() const
+{
+    return u_short + u_long;
+}
+
+const MDStats &MDIntegrator::stats() const
+{
+    return counters;
+}
+
+const numa_vector<std::array<double, 3>> &MDIntegrator::forces() const
+{
+    return f_short;
+}
+
+void MDIntegrator::set_temperature(double T)
+{
+    opt.temperature = T;
+}
+
+double MDIntegrator::temperature() const
+{
+    return opt.temperature;
+}
+
+void MDIntegrator::thermostat(double dt)
+{
+    if (opt.temperature <= 0.0)
+        return;
+    // Exact Ornstein-Uhlenbeck step for unit masses. Serial so that a seed
+    // gives the same trajectory on any thread count.
+    const double c1 = std::exp(-opt.friction * dt);
+    const double c2 = std::sqrt((1.0 - c1 * c1) * opt.temperature);
+    std::normal_distribution<double> gauss;
+    for (auto &mol : system.get_molecules())
+    {
+        for (double &v : mol.get_velocities())
+            v = c1 * v + c2 * gauss(rng);
+    }
+}
+
+void MDIntegrator::update_lists()
+{
+    auto &molecules = system.get_molecules();
+    if (!outer.needs_rebuild(molecules))
+        return;
+
+    auto t0 = std::chrono::steady_clock::now();
+    // Wrap before rebuilding; the lists take their displacement reference here.
+    const double box = system.get_box_size();
+    const long n = static_cast<long>(molecules.size());
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        for (double &x : molecules[i].get_coordinates())
+            x -= box * std::floor(x / box);
+    }
+    outer.build(molecules);
+    if (respa)
+        inner.build_from(outer, molecules);
+    counters.rebuilds++;
+    counters.build_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void MDIntegrator::short_forces()
+{
+    auto t0 = std::chrono::steady_clock::now();
+    if (respa)
+        u_short = lj_forces(system.get_molecules(), system.get_box_size(), inner, ForceRange::Short, split, f_short);
+    else
+        u_short = lj_forces(system.get_molecules(), system.get_box_size(), outer, ForceRange::Full, split, f_short);
+    counters.short_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void MDIntegrator::long_forces()
+{
+    auto t0 = std::chrono::steady_clock::now();
+    u_long = lj_forces(system.get_molecules(), system.get_box_size(), outer, ForceRange::Long, split, f_long);
+    counters.long_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void MDIntegrator::kick(const numa_vector<std::array<double, 3>> &f, double dt)
+{
+    auto &molecules = system.get_molecules();
+    const long n = static_cast<long>(molecules.size());
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        auto &v = molecules[i].get_velocities();
+        for (int d = 0; d < 3; d++)
+            v[d] += dt * f[i][d];
+    }
+}
+
+void MDIntegrator::drift(double dt)
+{
+    auto &molecules = system.get_molecules();
+    const long n = static_cast<long>(molecules.size());
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        auto &x = molecules[i].get_coordinates();
+        const auto &v = molecules[i].get_velocities();
+        for (int d = 0; d < 3; d++)
+            x[d] += dt * v[d];
+    }
+}
+
+void MDIntegrator::run(long steps)
+{
+    const int k = opt.respa_steps;
+    const double dt = opt.dt;
+    for (long done = 0; done < steps; done += k)
+    {
+        // Outer half kick, k inner velocity Verlet steps, outer half kick
+        if (respa)
+            kick(f_long, 0.5 * k * dt);
+        for (int s = 0; s < k; s++)
+        {
+            kick(f_short, 0.5 * dt);
+            drift(dt);
+            update_lists();
+            short_forces();
+            kick(f_short, 0.5 * dt);
+            thermostat(dt);
+        }
+        if (respa)
+        {
+            long_forces();
+            kick(f_long, 0.5 * k * dt);
+        }
+        counters.steps += k;
+    }
+}
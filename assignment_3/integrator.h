@@ -0,0 +1,75 @@
+// integrator.h
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "forces.h"
+#include "molecularsystem.h"
+#include "neighborlist.h"
+#include "numa.h"
+#include <array>
+#include <random>
+
+struct MDOptions
+{
+    double dt = 0.005;          // inner time step
+    int respa_steps = 1;        // inner steps per long-range force update; 1 = plain velocity Verlet
+    double inner_cutoff = 1.5;  // short-range forces end here...
+    double switch_width = 0.3;  // ...switching off over this width
+    double skin = 0.3;          // Verlet list skin
+    double temperature = 0.0;   // Langevin thermostat target; 0 = NVE
+    double friction = 1.0;      // Langevin friction coefficient
+    unsigned long seed = 1;     // thermostat noise
+};
+
+struct MDStats
+{
+    long steps = 0;
+    long rebuilds = 0;
+    double build_ms = 0.0;
+    double short_ms = 0.0; // short-range (or full, without r-RESPA) forces
+    double long_ms = 0.0;
+};
+
+// Velocity Verlet on a MolecularSystem (unit masses, LJ with the 2.5 sigma
+// cutoff), optionally with r-RESPA: the short-range part of the split
+// potential is integrated with dt from a tight list, the outer shell with
+// respa_steps * dt from the full list. With a temperature set, each step
+// ends with a Langevin velocity update (friction plus matching noise), which
+// samples the canonical ensemble. Positions and velocities are updated in the
+// system's molecules.
+class MDIntegrator
+{
+public:
+    MDIntegrator(MolecularSystem &system, const MDOptions &options = MDOptions());
+
+    // Advance by steps * dt; with r-RESPA, rounded up to whole outer steps.
+    void run(long steps);
+
+    // Of the current positions, from the last force evaluation.
+    double potential_energy() const;
+    // Thermostat target; velocities are not rescaled.
+    void set_temperature(double T);
+    double temperature() const;
+    const MDStats &stats() const;
+    const numa_vector<std::array<double, 3>> &forces() const;
+
+private:
+    void update_lists();
+    void short_forces();
+    void long_forces();
+    void kick(const numa_vector<std::array<double, 3>> &f, double dt);
+    void drift(double dt);
+    void thermostat(double dt);
+
+    MolecularSystem &system;
+    MDOptions opt;
+    ForceSplit split;
+    bool respa;
+    NeighborList outer, inner;
+    numa_vector<std::array<double, 3>> f_short, f_long;
+    double u_short, u_long;
+    MDStats counters;
+    std::mt19937_64 rng;
+};
+
+#endif
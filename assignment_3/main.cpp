@@ -6,9 +6,13 @@
 #include <cstdlib>
 #include <chrono>
 #include <fstream>
+#include <memory>
 
 #include "molecule.h"
 #include "molecularsystem.h"
+#include "halogrid.h"
+#include "numa.h"
+#include "perfcounters.h"
 
 // Declarations for file reading
 std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
@@ -16,10 +20,20 @@ std::vector<std::array<double, 3>> readXYZVelocities(const std::string &filename
 
 int main(int argc, char *argv[])
 {
+    // --perf: hardware counters per phase of the linked-cell evaluation
+    // --reproducible: energy sums independent of the thread count
+    const char *program = argv[0];
+    bool use_perf = false, reproducible = false;
+    while (argc > 1 && (std::string(argv[1]) == "--perf" || std::string(argv[1]) == "--reproducible"))
+    {
+        (std::string(argv[1]) == "--perf" ? use_perf : reproducible) = true;
+        argv++;
+        argc--;
+    }
     if (argc < 3 || argc > 4)
     {
-        std::cerr << "Usage: " << argv[0]
-                  << " <box_size> <positions_file> [<velocities_file>]\n";
+        std::cerr << "Usage: " << program
+                  << " [--perf] [--reproducible] <box_size> <positions_file> [<velocities_file>]\n";
         return 1;
     }
 
@@ -30,9 +44,11 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // Pin threads before any data is allocated so first touch is meaningful.
+    pin_threads();
+
     // Read positions
     auto positions = readXYZPositions(box_size, argv[2]);
-    auto positions = readXYZ(argv[2]);
     std::cout << "Positions read: " << positions.size() << std::endl;
 
     // Read velocities if provided
@@ -40,7 +56,6 @@ int main(int argc, char *argv[])
     if (argc == 4)
     {
         velocities = readXYZVelocities(argv[3]);
-        velocities = readXYZ(argv[3]);
         std::cout << "Velocities read: " << velocities.size() << std::endl;
         if (positions.size() != velocities.size())
         {
@@ -56,14 +71,14 @@ int main(int argc, char *argv[])
 
     // Create molecular system
     MolecularSystem system(box_size);
-    // Initilize molecular system
-    MolecularSystem system(boxSize);
+    if (reproducible)
+        system.set_reproducible(true);
+    system.reserve(positions.size());
 
     // Add molecules to the system
     for (std::size_t i = 0; i < positions.size(); ++i)
     {
         system.add_molecule(Molecule(
-        system.addMolecule(Molecule(
             static_cast<int>(i),
             positions[i][0], positions[i][1], positions[i][2],
             velocities[i][0], velocities[i][1], velocities[i][2]));
@@ -78,36 +93,33 @@ int main(int argc, char *argv[])
     auto end = std::chrono::steady_clock::now();
     std::chrono::duration<double, std::milli> elapsed_orig = end - start;
 
+    std::unique_ptr<PerfCounters> perf;
+    if (use_perf)
+        perf = std::make_unique<PerfCounters>();
     start = std::chrono::steady_clock::now();
-    double E_pot_cells = system.total_potential_energy_LinkedCells();
+    double E_pot_cells = system.total_potential_energy_LinkedCells(perf.get());
     end = std::chrono::steady_clock::now();
     std::chrono::duration<double, std::milli> elapsed_cells = end - start;
 
-    // Output results and speedup
-    std::cout << "E_pot = " << E_pot_cells << ". (Linked cells, " << elapsed_cells.count() << " ms.)\n";
-    std::cout << "E_pot = " << E_pot_orig << ". (Original, " << elapsed_orig.count() << " ms.)\n";
-
-    double E_kin = system.totalKineticEnergy();
-    std::cout << "Computed kinetic energy: " << E_kin << std::endl;
-
-    // Compute potential energy using original method
-    auto start = std::chrono::high_resolution_clock::now();
-    double E_pot_orig = system.totalPotentialEnergy();
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> elapsed_orig = end - start;
+    start = std::chrono::steady_clock::now();
+    double E_pot_clusters = system.total_potential_energy_ClusterPairs();
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed_clusters = end - start;
 
-    // Compute potential energy using linked cells
-    start = std::chrono::high_resolution_clock::now();
-    double E_pot_cells = system.totalPotentialEnergyLinkedCells();
-    end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> elapsed_cells = end - start;
+    HaloStats halo_stats;
+    start = std::chrono::steady_clock::now();
+    double E_pot_halo = system.total_potential_energy_HaloCells(&halo_stats);
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed_halo = end - start;
 
     // Output results and speedup
-    std::cout << "E_pot = " << E_pot_cells << ". (Using linked-cell data structure, taking "
-              << elapsed_cells.count() << " ms.)\n";
-    std::cout << "E_pot = " << E_pot_orig << ". (Computed without using linked cells, taking "
-              << elapsed_orig.count() << " ms.)\n";
-    std::cout << "#\n";
+    std::cout << "E_pot = " << E_pot_cells << ". (Linked cells, " << elapsed_cells.count() << " ms.)\n";
+    std::cout << "E_pot = " << E_pot_halo << ". (Halo cells, " << elapsed_halo.count() << " ms: "
+              << halo_stats.build_ms << " binning, " << halo_stats.halo_ms << " halo ("
+              << halo_stats.halo_particles << " images), " << halo_stats.pair_ms << " pairs ("
+              << halo_stats.interior_pairs << " interior, " << halo_stats.halo_pairs << " halo).)\n";
+    std::cout << "E_pot = " << E_pot_clusters << ". (Cluster pairs, " << elapsed_clusters.count() << " ms.)\n";
+    std::cout << "E_pot = " << E_pot_orig << ". (Original, " << elapsed_orig.count() << " ms.)\n";
 
     if (elapsed_cells.count() > 0)
     {
@@ -115,10 +127,13 @@ int main(int argc, char *argv[])
         std::cout << "Speedup factor from linked cells: " << speedup << std::endl;
     }
 
+    if (perf)
+        perf->report(std::cout);
+
     double E_total = E_kin + E_pot_orig;
     std::cout << "E_kin = " << E_kin << "\n"
               << "E_pot = " << E_pot_orig << "\n"
               << "E_kin + E_pot = " << E_total << "\n";
 
     return 0;
-}
\ No newline at end of file
+}
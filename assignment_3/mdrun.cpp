@@ -0,0 +1,137 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+#include "molecule.h"
+#include "molecularsystem.h"
+#include "integrator.h"
+#include "correlator.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+std::vector<std::array<double, 3>> readXYZVelocities(const std::string &filename);
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> files;
+    MDOptions options;
+    long steps = 1000;
+    long report = 100;
+    long correlate = 0;
+    for (int k = 1; k < argc; k++)
+    {
+        const std::string arg = argv[k];
+        if (arg == "--steps" && k + 1 < argc)
+            steps = std::atol(argv[++k]);
+        else if (arg == "--dt" && k + 1 < argc)
+            options.dt = std::atof(argv[++k]);
+        else if (arg == "--respa" && k + 1 < argc)
+            options.respa_steps = std::atoi(argv[++k]);
+        else if (arg == "--inner" && k + 1 < argc)
+            options.inner_cutoff = std::atof(argv[++k]);
+        else if (arg == "--report" && k + 1 < argc)
+            report = std::atol(argv[++k]);
+        else if (arg == "--correlate" && k + 1 < argc)
+            correlate = std::atol(argv[++k]);
+        else
+            files.push_back(arg);
+    }
+    if (files.size() < 2 || files.size() > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <box_size> <positions_file> [<velocities_file>]"
+                  << " [--steps N] [--dt dt] [--respa k] [--inner r] [--report N] [--correlate N]\n";
+        return 1;
+    }
+
+    double box_size = std::atof(files[0].c_str());
+    if (box_size < 5.0)
+    {
+        std::cerr << "Error: box_size must be at least 5.\n";
+        return 1;
+    }
+
+    pin_threads();
+
+    auto positions = readXYZPositions(box_size, files[1]);
+    std::vector<std::array<double, 3>> velocities(positions.size(), {0.0, 0.0, 0.0});
+    if (files.size() == 3)
+    {
+        velocities = readXYZVelocities(files[2]);
+        if (positions.size() != velocities.size())
+        {
+            std::cerr << "Error: positions and velocities must have the same size.\n";
+            return 1;
+        }
+    }
+    MolecularSystem system(box_size);
+    system.reserve(positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i)
+    {
+        system.add_molecule(Molecule(static_cast<int>(i),
+                                     positions[i][0], positions[i][1], positions[i][2],
+                                     velocities[i][0], velocities[i][1], velocities[i][2]));
+    }
+
+    try
+    {
+        MDIntegrator md(system, options);
+        const double E0 = system.total_kinetic_energy() + md.potential_energy();
+        std::cout << "N = " << positions.size() << ", dt = " << options.dt
+                  << ", r-RESPA steps = " << options.respa_steps << "\n";
+        std::cout << "step E_kin E_pot E_total\n";
+        std::cout << 0 << " " << system.total_kinetic_energy() << " " << md.potential_energy() << " " << E0 << "\n";
+
+        // MSD / VACF sampled every `correlate` steps, if asked for
+        std::unique_ptr<MultiTauCorrelator> correlator;
+        if (correlate > 0)
+        {
+            correlator = std::make_unique<MultiTauCorrelator>(positions.size(), box_size, correlate * options.dt);
+            correlator->sample(system.get_molecules());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        double max_drift = 0.0;
+        for (long done = 0; done < steps;)
+        {
+            long chunk = std::min(report - done % report, steps - done);
+            if (correlator)
+                chunk = std::min(chunk, correlate - done % correlate);
+            md.run(chunk);
+            done = md.stats().steps;
+            if (correlator && done % correlate == 0)
+                correlator->sample(system.get_molecules());
+            if (done % report != 0 && done != steps)
+                continue;
+            const double E_kin = system.total_kinetic_energy();
+            const double E = E_kin + md.potential_energy();
+            max_drift = std::max(max_drift, std::abs(E - E0));
+            std::cout << done << " " << E_kin << " " << md.potential_energy() << " " << E << "\n";
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        const MDStats &s = md.stats();
+        std::cout << "Max |E - E0| per particle: " << max_drift / positions.size() << "\n"
+                  << "Time: " << elapsed.count() << " ms (short/full forces " << s.short_ms
+                  << " ms, long forces " << s.long_ms << " ms, " << s.rebuilds << " list builds "
+                  << s.build_ms << " ms)\n";
+        if (correlator)
+        {
+            std::cout << "lag MSD VACF samples\n";
+            for (const auto &c : correlator->results())
+                std::cout << c.lag << " " << c.msd << " " << c.vacf << " " << c.samples << "\n";
+            std::cout << "D (MSD slope) = " << correlator->diffusion_msd()
+                      << ", D (VACF integral) = " << correlator->diffusion_vacf() << "\n";
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
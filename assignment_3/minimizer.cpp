@@ -0,0 +1,201 @@
+#include "minimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+// FIRE 2.0 parameters (Guenole et al., Comput. Mater. Sci. 175, 109584)
+const int fire_n_delay = 20;
+const double fire_f_inc = 1.1;
+const double fire_f_dec = 0.5;
+const double fire_alpha_start = 0.25;
+const double fire_f_alpha = 0.99;
+const double fire_dt_min_ratio = 0.02; // dt never drops below this * dt_start
+// Consecutive uphill FIRE steps before a burst of steepest descent
+const int max_uphill = 10;
+const int sd_burst = 10;
+// Steepest descent step per unit force, before the max_step cap
+const double sd_gamma = 1e-3;
+} // namespace
+
+FireMinimizer::FireMinimizer(MolecularSystem &system, const MinimizeOptions &options)
+    : system(system), opt(options), list(system.get_box_size(), 2.5, options.skin),
+      max_force(0.0), rebuilds(0)
+{
+}
+
+// Forces and energy at the current positions, rebuilding the list if needed.
+double FireMinimizer::evaluate()
+{
+    auto &molecules = system.get_molecules();
+    if (list.needs_rebuild(molecules))
+    {
+        const double box = system.get_box_size();
+        const long n = static_cast<long>(molecules.size());
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < n; i++)
+        {
+            for (double &x : molecules[i].get_coordinates())
+                x -= box * std::floor(x / box);
+        }
+        list.build(molecules);
+        rebuilds++;
+    }
+    const double energy = lj_forces(molecules, system.get_box_size(), list, ForceRange::Full,
+                                    ForceSplit{2.5, 2.5}, forces);
+
+    const long n = static_cast<long>(molecules.size());
+    double f2_max = 0.0;
+#pragma omp parallel for reduction(max : f2_max) schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        const auto &f = forces[i];
+        f2_max = std::max(f2_max, f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    }
+    max_force = std::sqrt(f2_max);
+    return energy;
+}
+
+// Each molecule moves along its force, at most max_step.
+void FireMinimizer::steepest_descent_step()
+{
+    auto &molecules = system.get_molecules();
+    const long n = static_cast<long>(molecules.size());
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        const auto &f = forces[i];
+        const double norm = std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+        const double scale = norm > 0.0 ? std::min(sd_gamma, opt.max_step / norm) : 0.0;
+        auto &x = molecules[i].get_coordinates();
+        for (int d = 0; d < 3; d++)
+            x[d] += scale * f[d];
+        velocities[i] = {0.0, 0.0, 0.0};
+    }
+}
+
+// Semi-implicit Euler step of the FIRE dynamics: kick, mix the kicked
+// velocities towards the force, then move with the displacement capped.
+// v_norm is |v| after the kick.
+void FireMinimizer::fire_step(double dt, double alpha, double v_norm, double f_norm)
+{
+    auto &molecules = system.get_molecules();
+    const long n = static_cast<long>(molecules.size());
+    const double mix = f_norm > 0.0 ? alpha * v_norm / f_norm : 0.0;
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        auto &v = velocities[i];
+        for (int d = 0; d < 3; d++)
+            v[d] = (1.0 - alpha) * (v[d] + dt * forces[i][d]) + mix * forces[i][d];
+        const double step = dt * std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        const double scale = step > opt.max_step ? opt.max_step / step : 1.0;
+        auto &x = molecules[i].get_coordinates();
+        for (int d = 0; d < 3; d++)
+            x[d] += scale * dt * v[d];
+    }
+}
+
+// Undoes half of the last move and stops, after FIRE ran uphill.
+void FireMinimizer::step_back(double dt)
+{
+    auto &molecules = system.get_molecules();
+    const long n = static_cast<long>(molecules.size());
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        auto &v = velocities[i];
+        const double step = dt * std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        const double scale = step > opt.max_step ? opt.max_step / step : 1.0;
+        auto &x = molecules[i].get_coordinates();
+        for (int d = 0; d < 3; d++)
+            x[d] -= 0.5 * scale * dt * v[d];
+        v = {0.0, 0.0, 0.0};
+    }
+}
+
+MinimizeResult FireMinimizer::run()
+{
+    auto t0 = std::chrono::steady_clock::now();
+    auto &molecules = system.get_molecules();
+    const long n = static_cast<long>(molecules.size());
+    velocities.assign(n, {0.0, 0.0, 0.0});
+
+    MinimizeResult result;
+    double energy = evaluate();
+    double dt = opt.dt_start, alpha = fire_alpha_start;
+    int n_positive = 0, uphill = 0, sd_left = 0, flat = 0;
+
+    while (result.iterations < opt.max_iterations)
+    {
+        if (max_force < opt.force_tol || flat >= 10)
+        {
+            result.converged = true;
+            break;
+        }
+        result.iterations++;
+
+        if (max_force > opt.sd_force || sd_left > 0)
+        {
+            steepest_descent_step();
+            result.sd_iterations++;
+            sd_left = std::max(0, sd_left - 1);
+            dt = opt.dt_start;
+            alpha = fire_alpha_start;
+            n_positive = 0;
+        }
+        else
+        {
+            // P = F . v and the norms for the velocity mixing
+            double power = 0.0, v2 = 0.0, f2 = 0.0;
+#pragma omp parallel for reduction(+ : power, v2, f2) schedule(static)
+            for (long i = 0; i < n; i++)
+            {
+                for (int d = 0; d < 3; d++)
+                {
+                    power += forces[i][d] * velocities[i][d];
+                    v2 += velocities[i][d] * velocities[i][d];
+                    f2 += forces[i][d] * forces[i][d];
+                }
+            }
+            if (power > 0.0)
+            {
+                if (++n_positive > fire_n_delay)
+                {
+                    dt = std::min(dt * fire_f_inc, opt.dt_max);
+                    alpha *= fire_f_alpha;
+                }
+                uphill = 0;
+            }
+            else if (v2 > 0.0)
+            {
+                // Uphill; starting from rest (after steepest descent) is not
+                n_positive = 0;
+                dt = std::max(dt * fire_f_dec, fire_dt_min_ratio * opt.dt_start);
+                alpha = fire_alpha_start;
+                step_back(dt);
+                power = v2 = 0.0;
+                if (++uphill >= max_uphill)
+                {
+                    sd_left = sd_burst;
+                    uphill = 0;
+                }
+            }
+            // |v + dt F|^2 = v^2 + 2 dt P + dt^2 F^2
+            const double kicked2 = v2 + 2.0 * dt * power + dt * dt * f2;
+            fire_step(dt, alpha, std::sqrt(std::max(kicked2, 0.0)), std::sqrt(f2));
+        }
+
+        const double previous = energy;
+        energy = evaluate();
+        const double change = std::abs(energy - previous) / std::max(1.0, std::abs(energy));
+        flat = change < opt.energy_tol ? flat + 1 : 0;
+    }
+
+    result.energy = energy;
+    result.max_force = max_force;
+    result.rebuilds = rebuilds;
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return result;
+}
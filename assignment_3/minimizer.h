@@ -0,0 +1,62 @@
+// minimizer.h
+#ifndef MINIMIZER_H
+#define MINIMIZER_H
+
+#include "forces.h"
+#include "molecularsystem.h"
+#include "neighborlist.h"
+#include "numa.h"
+#include <array>
+
+struct MinimizeOptions
+{
+    double force_tol = 1e-2;    // stop when the largest force is below this...
+    double energy_tol = 1e-10;  // ...or |dE| / |E| stays below this for 10 iterations
+    int max_iterations = 20000;
+    double dt_start = 0.01;     // FIRE time step, grows up to dt_max
+    double dt_max = 0.1;
+    double max_step = 0.2;      // no molecule moves further per iteration
+    double sd_force = 1e3;      // steepest descent while the largest force exceeds this
+    double skin = 0.5;
+};
+
+struct MinimizeResult
+{
+    bool converged = false;
+    int iterations = 0;
+    int sd_iterations = 0;  // of which steepest descent
+    long rebuilds = 0;
+    double energy = 0.0;
+    double max_force = 0.0;
+    double ms = 0.0;
+};
+
+// FIRE energy minimisation (Bitzek et al., PRL 97, 170201, with the FIRE 2.0
+// integration of Guenole et al. 2020) of a system's positions, with steepest
+// descent for overlapping starts. While forces are
+// huge, or when FIRE keeps running uphill, molecules step along their force
+// with a capped length instead. The neighbour list is kept across
+// iterations and rebuilt only after molecules have moved half its skin.
+// Velocities of the molecules are left unchanged.
+class FireMinimizer
+{
+public:
+    FireMinimizer(MolecularSystem &system, const MinimizeOptions &options = MinimizeOptions());
+
+    MinimizeResult run();
+
+private:
+    double evaluate();
+    void steepest_descent_step();
+    void fire_step(double dt, double alpha, double v_norm, double f_norm);
+    void step_back(double dt);
+
+    MolecularSystem &system;
+    MinimizeOptions opt;
+    NeighborList list;
+    numa_vector<std::array<double, 3>> forces, velocities;
+    double max_force;
+    long rebuilds;
+};
+
+#endif
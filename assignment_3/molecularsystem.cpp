@@ -1,21 +1,62 @@
 #include "molecularsystem.h"
 #include "molecule.h"
+#include "cellgrid.h"
+#include "partition.h"
+#include "smallbox.h"
+#include "reduction.h"
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <omp.h>
 #include <vector>
 
-MolecularSystem::MolecularSystem(double a) : box_size(a) {}
+MolecularSystem::MolecularSystem(double a) : box_size(a)
+{
+    const char *env = std::getenv("MOLSIM_REPRODUCIBLE");
+    reproducible_sums = env && std::strcmp(env, "1") == 0;
+}
+
+void MolecularSystem::set_reproducible(bool on)
+{
+    reproducible_sums = on;
+}
+
+bool MolecularSystem::reproducible() const
+{
+    return reproducible_sums;
+}
+
+void MolecularSystem::reserve(size_t n)
+{
+    molecules.reserve(n);
+    generation++;
+}
 
 void MolecularSystem::add_molecule(const Molecule &mol)
 {
     molecules.push_back(mol);
+    generation++;
 }
 
-const std::vector<Molecule> &MolecularSystem::get_molecules() const
+double MolecularSystem::get_box_size() const
+{
+    return box_size;
+}
+
+const numa_vector<Molecule> &MolecularSystem::get_molecules() const
 {
     return molecules;
 }
 
+numa_vector<Molecule> &MolecularSystem::get_molecules()
+{
+    generation++;
+    return molecules;
+}
+
 double MolecularSystem::total_kinetic_energy() const
 {
     double kinetic_energy = 0.0;
@@ -30,272 +71,166 @@ double MolecularSystem::total_potential_energy() const
 {
     double potential_energy = 0.0;
     const size_t n = molecules.size();
+    numa_vector<double> rows(reproducible_sums ? n : 0);
 
 #pragma omp parallel for reduction(+ : potential_energy)
     for (size_t i = 0; i < n; i++)
     {
+        double row = 0.0;
         for (size_t j = i + 1; j < n; j++)
         {
-            potential_energy += molecules[i].potential_energy(molecules[j], box_size);
+            row += molecules[i].potential_energy(molecules[j], box_size);
         }
+        if (reproducible_sums)
+            rows[i] = row;
+        else
+            potential_energy += row;
     }
-    return potential_energy;
+    return reproducible_sums ? reproducible_sum(rows) : potential_energy;
 }
 
-double MolecularSystem::total_potential_energy_LinkedCells() const
+double MolecularSystem::total_potential_energy_SmallBox() const
 {
-    const double cell_size = 2.5;
-    double potential_energy = 0.0;
-    int num_cells = static_cast<int>(ceil(box_size / cell_size));
-    int num_cells_squared = num_cells * num_cells;
-    int num_cells_cubed = num_cells * num_cells * num_cells;
-
-    // Build linked cells
-    std::vector<std::vector<size_t>> cells(num_cells_cubed);
-    for (size_t i = 0; i < molecules.size(); i++)
-    {
-        const auto &pos = molecules[i].get_coordinates();
-        int cx = static_cast<int>(pos[0] / cell_size) % num_cells;
-        int cy = static_cast<int>(pos[1] / cell_size) % num_cells;
-        int cz = static_cast<int>(pos[2] / cell_size) % num_cells;
-        int idx = cx + cy * num_cells + cz * num_cells_squared;
-        cells[idx].push_back(i);
-    }
-
-    // Precompute neighbor indices to avoid recomputing in inner loops.
-    const int neighbor_count = 13;
-    const int neighbor_offsets[neighbor_count][3] = {
-        {0, 0, 1},
-        {0, 1, -1},
-        {0, 1, 0},
-        {0, 1, 1},
-        {1, -1, -1},
-        {1, -1, 0},
-        {1, -1, 1},
-        {1, 0, -1},
-        {1, 0, 0},
-        {1, 0, 1},
-        {1, 1, -1},
-        {1, 1, 0},
-        {1, 1, 1}};
-
-    std::vector<std::vector<int>> neighbor_indices(num_cells_cubed);
-    for (int cx = 0; cx < num_cells; cx++)
-    {
-        for (int cy = 0; cy < num_cells; cy++)
-        {
-            for (int cz = 0; cz < num_cells; cz++)
-            {
-                int cell_idx = cx + cy * num_cells + cz * num_cells_squared;
-                std::vector<int> neigh;
-                neigh.reserve(neighbor_count); // Reserve fixed space for neighbor indices
-                for (int n = 0; n < neighbor_count; n++)
-                {
-                    int nx = (cx + neighbor_offsets[n][0] + num_cells) % num_cells;
-                    int ny = (cy + neighbor_offsets[n][1] + num_cells) % num_cells;
-                    int nz = (cz + neighbor_offsets[n][2] + num_cells) % num_cells;
-                    int neighbor_idx = nx + ny * num_cells + nz * num_cells_squared;
-                    neigh.push_back(neighbor_idx);
-                }
-                neighbor_indices[cell_idx] = neigh;
-            }
-        }
-    }
-
-#pragma omp parallel for reduction(+ : potential_energy) schedule(dynamic)
-    for (int cell_idx = 0; cell_idx < num_cells_cubed; cell_idx++)
-    {
-        const std::vector<size_t> &currentCell = cells[cell_idx];
-        for (size_t i = 0; i < currentCell.size(); i++)
-        {
-            // Interactions within the same cell.
-            for (size_t j = i + 1; j < currentCell.size(); j++)
-            {
-                potential_energy += molecules[currentCell[i]].potential_energy(molecules[currentCell[j]], box_size);
-            }
-            // Interactions with neighbor cells.
-            for (int neighbor : neighbor_indices[cell_idx])
-            {
-                const std::vector<size_t> &neighborCell = cells[neighbor];
-                for (size_t j = 0; j < neighborCell.size(); j++)
-                {
-                    potential_energy += molecules[currentCell[i]].potential_energy(molecules[neighborCell[j]], box_size);
-                }
-            }
-        }
-    }
-    return potential_energy;
+    return small_box_energy(molecules, box_size, 2.5, reproducible_sums);
 }
 
-double MolecularSystem::total_energy() const
-{
-    return total_kinetic_energy() + total_potential_energy();
-}
-#include <cmath>
-#include <algorithm>
-#include "molecule.h"
-
-MolecularSystem::MolecularSystem(double boxSize) : m_boxSize(boxSize)
-{
-}
-
-void MolecularSystem::addMolecule(const Molecule &molecule)
+double MolecularSystem::total_potential_energy_LinkedCells() const
 {
-    m_molecules.push_back(molecule);
+    return linked_cells_energy(Phases{});
 }
 
-double MolecularSystem::totalKineticEnergy() const
+double MolecularSystem::linked_cells_energy(const Phases &phases, double *pair_sum) const
 {
-    double E_kin = 0.0;
-    for (const auto &molecule : m_molecules)
+    auto phase_begin = [&phases](const char *phase)
     {
-        E_kin += molecule.kinetic_energy();
-    }
-    return E_kin;
-}
-
-double MolecularSystem::totalPotentialEnergy() const
-{
-    double E_pot = 0.0;
-    const size_t N = m_molecules.size();
-
-    for (size_t i = 0; i < N; i++)
+        if (phases.begin)
+            phases.begin(phase);
+    };
+    auto phase_end = [&phases](const char *phase)
     {
-        for (size_t j = i + 1; j < N; j++)
-        {
-            E_pot += m_molecules[i].potential_energy(m_molecules[j], m_boxSize);
-        }
-    }
-
-    return E_pot;
-}
-
-int MolecularSystem::determineOptimalCellCount() const
-{
-    // Minimum cell size is 2.5 (cutoff distance)
-    // For very small systems or low density, don't use linked cells
-    if (m_molecules.size() < 100 || m_boxSize < 7.5)
+        if (phases.end)
+            phases.end(phase);
+    };
+
+    if (pair_sum)
+        *pair_sum = 0.0;
+    phase_begin("stencil");
+    CellGrid grid(box_size, phases.cell_size);
+    phase_end("stencil");
+
+    // Fewer than 3 cells per side: the half stencil would revisit cells.
+    if (grid.cells_per_side() < 3)
     {
-        return 0; // No linked cells
+        return total_potential_energy_SmallBox();
     }
 
-    // Calculate cell count to give cells slightly larger than cutoff distance
-    int cellCount = static_cast<int>(m_boxSize / 2.5);
-
-    // Make sure we have at least 2 cells per dimension
-    cellCount = std::max(2, cellCount);
-
-    // For very large systems, cap at a reasonable number
-    cellCount = std::min(cellCount, 20);
-
-    return cellCount;
-}
-
-double MolecularSystem::totalPotentialEnergyLinkedCells() const
-{
-    int numCells = determineOptimalCellCount();
-
-    // If system is too small, revert to original method
-    if (numCells <= 0)
+    phase_begin("binning");
+    grid.build(molecules);
+    phase_end("binning");
+    if (phases.binned)
+        phases.binned(grid);
+    const auto &cell_start = grid.cell_start();
+    const auto &pos = grid.positions();
+
+    // Chunks of equal estimated pair work, several per thread, in cell order.
+    // A static schedule keeps each thread on the contiguous block of cells it
+    // first-touched while building the grid.
+    phase_begin("partition");
+    const std::vector<CellChunk> chunks = partition_cells(grid, 8 * omp_get_max_threads());
+    phase_end("partition");
+    const int num_chunks = static_cast<int>(chunks.size());
+    double potential_energy = 0.0, term = 0.0;
+    // Reproducible mode: one partial sum per slot, whatever chunk it is in
+    numa_vector<double> rows(reproducible_sums ? pos.size() : 0);
+    numa_vector<double> term_rows(reproducible_sums && phases.pair_term ? pos.size() : 0);
+    const double term_cutoff2 = phases.pair_cutoff * phases.pair_cutoff;
+    if (phases.pairs)
     {
-        return totalPotentialEnergy();
+        // The cost model counts exactly the distance checks of the loop below
+        const std::vector<double> costs = cell_costs(grid);
+        phases.pairs(std::accumulate(costs.begin(), costs.end(), 0.0));
     }
 
-    double E_pot = 0.0;
-    double cellSize = m_boxSize / numCells;
+    phase_begin("pairs");
 
-    // Create a 3D grid of cells, each containing a list of molecule indices
-    std::vector<std::vector<std::vector<std::vector<size_t>>>> cells(
-        numCells, std::vector<std::vector<std::vector<size_t>>>(
-                      numCells, std::vector<std::vector<size_t>>(
-                                    numCells, std::vector<size_t>())));
-
-    // Sort molecules into cells
-    for (size_t i = 0; i < m_molecules.size(); i++)
+    // Instantiated with and without the extra term, so plain LJ pays
+    // nothing for it
+    auto traverse = [&](auto with_term)
     {
-        const auto &coords = m_molecules[i].getCoordinates();
-
-        // Calculate cell indices, handling periodic boundary conditions
-        int x = static_cast<int>(std::floor(coords[0] / cellSize)) % numCells;
-        int y = static_cast<int>(std::floor(coords[1] / cellSize)) % numCells;
-        int z = static_cast<int>(std::floor(coords[2] / cellSize)) % numCells;
-
-        // Handle negative coordinates properly
-        if (x < 0)
-            x += numCells;
-        if (y < 0)
-            y += numCells;
-        if (z < 0)
-            z += numCells;
-
-        cells[x][y][z].push_back(i);
-    }
-
-    // Process each cell
-    for (int x = 0; x < numCells; x++)
-    {
-        for (int y = 0; y < numCells; y++)
+        auto pair = [&](size_t i, size_t j, double &row, double &row_term)
         {
-            for (int z = 0; z < numCells; z++)
+            double dx = pos[i][0] - pos[j][0];
+            double dy = pos[i][1] - pos[j][1];
+            double dz = pos[i][2] - pos[j][2];
+            dx -= box_size * std::round(dx / box_size);
+            dy -= box_size * std::round(dy / box_size);
+            dz -= box_size * std::round(dz / box_size);
+            const double r2 = dx * dx + dy * dy + dz * dz;
+            row += lj_energy_r2(r2);
+            if constexpr (decltype(with_term)::value)
             {
-                const auto &currentCell = cells[x][y][z];
+                if (r2 < term_cutoff2)
+                    row_term += phases.pair_term(i, j, r2);
+            }
+        };
 
-                // Process molecules within the same cell
-                for (size_t i = 0; i < currentCell.size(); i++)
+#pragma omp parallel for reduction(+ : potential_energy, term) schedule(static)
+        for (int k = 0; k < num_chunks; k++)
+        {
+            const CellChunk &chunk = chunks[k];
+            for (int cell_idx = chunk.cell_begin; cell_idx < chunk.cell_end; cell_idx++)
+            {
+                const size_t begin = std::max(cell_start[cell_idx], chunk.slot_begin);
+                const size_t end = std::min(cell_start[cell_idx + 1], chunk.slot_end);
+                for (size_t i = begin; i < end; i++)
                 {
-                    for (size_t j = i + 1; j < currentCell.size(); j++)
+                    double row = 0.0, row_term = 0.0;
+                    // Interactions within the same cell.
+                    for (size_t j = i + 1; j < cell_start[cell_idx + 1]; j++)
                     {
-                        E_pot += m_molecules[currentCell[i]].potential_energy(
-                            m_molecules[currentCell[j]], m_boxSize);
+                        pair(i, j, row, row_term);
                     }
-                }
-
-                // Process interactions with neighboring cells
-                for (int dx = -1; dx <= 1; dx++)
-                {
-                    for (int dy = -1; dy <= 1; dy++)
+                    // Interactions with neighbor cells.
+                    for (int neighbor : grid.half_stencil(cell_idx))
                     {
-                        for (int dz = -1; dz <= 1; dz++)
+                        for (size_t j = cell_start[neighbor]; j < cell_start[neighbor + 1]; j++)
                         {
-                            if (dx == 0 && dy == 0 && dz == 0)
-                                continue; // Skip current cell (already processed)
-
-                            // Calculate neighbor cell indices with periodic boundary conditions
-                            int nx = (x + dx + numCells) % numCells;
-                            int ny = (y + dy + numCells) % numCells;
-                            int nz = (z + dz + numCells) % numCells;
-
-                            const auto &neighborCell = cells[nx][ny][nz];
-
-                            // Calculate interactions between molecules in current cell and neighbor cell
-                            for (size_t i = 0; i < currentCell.size(); i++)
-                            {
-                                for (size_t j = 0; j < neighborCell.size(); j++)
-                                {
-                                    // Avoid double counting by only processing each pair once
-                                    if (currentCell[i] < neighborCell[j])
-                                    {
-                                        E_pot += m_molecules[currentCell[i]].potential_energy(
-                                            m_molecules[neighborCell[j]], m_boxSize);
-                                    }
-                                }
-                            }
+                            pair(i, j, row, row_term);
                         }
                     }
+                    if (reproducible_sums)
+                    {
+                        rows[i] = row;
+                        if constexpr (decltype(with_term)::value)
+                            term_rows[i] = row_term;
+                    }
+                    else
+                    {
+                        potential_energy += row;
+                        term += row_term;
+                    }
                 }
             }
         }
-    }
-
-    return E_pot;
-}
+    };
+    if (phases.pair_term)
+        traverse(std::true_type{});
+    else
+        traverse(std::false_type{});
 
-double MolecularSystem::totalEnergy() const
-{
-    return totalKineticEnergy() + totalPotentialEnergy();
+    if (reproducible_sums)
+    {
+        potential_energy = reproducible_sum(rows);
+        if (phases.pair_term)
+            term = reproducible_sum(term_rows);
+    }
+    if (pair_sum)
+        *pair_sum = term;
+    phase_end("pairs");
+    return potential_energy;
 }
 
-const std::vector<Molecule> &MolecularSystem::getMolecules() const
+double MolecularSystem::total_energy() const
 {
-    return m_molecules;
+    return total_kinetic_energy() + total_potential_energy();
 }
@@ -1,47 +1,104 @@
-
 // molecularsystem.h
 #ifndef MOLECULARSYSTEM_H
 #define MOLECULARSYSTEM_H
 
 #include "molecule.h"
+#include "numa.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <array>
-#pragma once
-#include <vector>
-#include "molecule.h"
+
+class CellGrid;
+class PerfCounters;
+class SpatialIndex;
+struct HaloStats;
+struct EwaldOptions;
+struct EwaldEnergy;
+
+// The optional backends (halo cells, cluster pairs, SPME, the spatial index
+// and the profiled linked-cell pass) are defined next to the code they use,
+// so a binary only links the ones it calls.
 
 class MolecularSystem
 {
 public:
     MolecularSystem(double a);
+    // Reproducible mode: the energy sums below give the same bits on any
+    // thread count. Per-molecule partial sums are kept in a fixed order
+    // and combined by reproducible_sum(). Off by default unless the
+    // environment sets MOLSIM_REPRODUCIBLE=1.
+    void set_reproducible(bool on);
+    bool reproducible() const;
+    // Allocate (and NUMA first-touch) storage for n molecules up front.
+    void reserve(size_t n);
     void add_molecule(const Molecule &mol);
     double total_kinetic_energy() const;
     double total_potential_energy() const;
+    // Dense all-image sum for boxes with fewer than 3 cells per side; the
+    // cell-based backends fall back to it.
+    double total_potential_energy_SmallBox() const;
     double total_potential_energy_LinkedCells() const;
+    // The same, recording hardware counters for the stencil, binning,
+    // partition and pair phases if perf is not null.
+    double total_potential_energy_LinkedCells(PerfCounters *perf) const;
+    // Linked cells on a halo-padded grid: periodic images are copied once so
+    // the pair kernel needs no minimum-image rounding. Optionally reports the
+    // interior/halo split of the work.
+    double total_potential_energy_HaloCells(HaloStats *stats = nullptr) const;
+    // Cluster-pair backend; cluster_size is 4 or 8 (the SIMD width).
+    double total_potential_energy_ClusterPairs(int cluster_size = 4) const;
+    // LJ plus Coulomb (per-molecule charges) with smooth particle-mesh
+    // Ewald. The erfc real-space term is evaluated in the same linked-cell
+    // pass as LJ (cells of max(2.5, real_cutoff)); optionally reports the
+    // parts and timings.
+    double total_potential_energy_SPME() const;
+    double total_potential_energy_SPME(const EwaldOptions &options, EwaldEnergy *parts = nullptr) const;
     double total_energy() const;
-    const std::vector<Molecule> &get_molecules() const;
+    double get_box_size() const;
+    const numa_vector<Molecule> &get_molecules() const;
+    // Mutable access counts as a change of the molecules: it marks the
+    // spatial index out of date.
+    numa_vector<Molecule> &get_molecules();
+    // Persistent spatial index (2.5 sigma cells) for range, pair and kNN
+    // queries. Built only by update_spatial_index(); spatial_index() throws
+    // std::runtime_error if there is none or the molecules were added to or
+    // handed out for writing since. Writes through pointers or views taken
+    // earlier are not seen: call update_spatial_index() after them.
+    // spatial_index() does not modify the system, so it may run on several
+    // threads at once, also while another thread calls
+    // update_spatial_index(); the returned snapshot stays valid.
+    std::shared_ptr<const SpatialIndex> spatial_index() const;
+    void update_spatial_index();
 
 private:
+    // Phase hooks of the linked-cell pass; empty ones are skipped. pairs
+    // receives the number of distance checks before the pair phase. A term
+    // that shares the pass (SPME real space) sets cell_size, is shown the
+    // binned grid, and gets pair_term(slot i, slot j, r2) for every pair
+    // below pair_cutoff; the sum comes back in *pair_sum. Such callers
+    // handle boxes of fewer than 3 cells themselves.
+    struct Phases
+    {
+        std::function<void(const char *)> begin, end;
+        std::function<void(double)> pairs;
+        double cell_size = 2.5;
+        std::function<void(const CellGrid &)> binned;
+        std::function<double(std::size_t, std::size_t, double)> pair_term;
+        double pair_cutoff = 0.0;
+    };
+    double linked_cells_energy(const Phases &phases, double *pair_sum = nullptr) const;
+
     double box_size;
-    std::vector<Molecule> molecules;
-    int determineOptimalCellCount() const;
+    bool reproducible_sums;
+    numa_vector<Molecule> molecules;
+    // Bumped by every mutable access to the molecules
+    std::uint64_t generation = 0;
+    // Immutable snapshot with the generation it was built at; shared with
+    // copies, replaced atomically by update_spatial_index()
+    struct BuiltIndex;
+    std::shared_ptr<const BuiltIndex> index;
 };
 
 #endif
-    explicit MolecularSystem(double boxSize);
-
-    void addMolecule(const Molecule &molecule);
-
-    double totalKineticEnergy() const;
-    double totalPotentialEnergy() const;
-    double totalPotentialEnergyLinkedCells() const;
-    double totalEnergy() const;
-
-    const std::vector<Molecule> &getMolecules() const;
-
-private:
-    double m_boxSize;
-    std::vector<Molecule> m_molecules;
-
-    int determineOptimalCellCount() const;
-};
@@ -3,7 +3,6 @@
 
 Molecule::Molecule(int id, double x, double y, double z,
                    double vx, double vy, double vz)
-Molecule::Molecule(int id, double x, double y, double z, double vx, double vy, double vz)
     : m_id(id), m_coords({x, y, z}), m_vels({vx, vy, vz})
 {
 }
@@ -23,6 +22,26 @@ const std::array<double, 3> &Molecule::get_velocities() const
     return m_vels;
 }
 
+std::array<double, 3> &Molecule::get_coordinates()
+{
+    return m_coords;
+}
+
+std::array<double, 3> &Molecule::get_velocities()
+{
+    return m_vels;
+}
+
+double Molecule::get_charge() const
+{
+    return m_charge;
+}
+
+void Molecule::set_charge(double q)
+{
+    m_charge = q;
+}
+
 double Molecule::kinetic_energy(double mass) const
 {
     double vx = m_vels[0];
@@ -35,42 +54,6 @@ double Molecule::potential_energy(const Molecule &other,
                                   double boxSize,
                                   double epsilon,
                                   double sigma) const
-double Molecule::potential_energy(const Molecule &other, double boxSize, double epsilon) const
 {
-    // Lennard-Jones cutoff and shift
-    const double cutoffDistance = 2.5 * sigma;
-    const double cutoffDistance2 = cutoffDistance * cutoffDistance;
-    const double cutoffDistance6 = cutoffDistance2 * cutoffDistance2 * cutoffDistance2;
-    const double cutoffDistance12 = cutoffDistance6 * cutoffDistance6;
-    const double u_cut = 4.0 * epsilon * ((1.0 / cutoffDistance12) - (1.0 / cutoffDistance6));
-
-    // Minimum-image convention
-    double dx = m_coords[0] - other.m_coords[0];
-    double dy = m_coords[1] - other.m_coords[1];
-    double dz = m_coords[2] - other.m_coords[2];
-
-    // Apply periodic boundary conditions (minimum image)
-    // Apply periodic boundary conditions
-    dx -= boxSize * std::round(dx / boxSize);
-    dy -= boxSize * std::round(dy / boxSize);
-    dz -= boxSize * std::round(dz / boxSize);
-
-    double r2 = dx * dx + dy * dy + dz * dz;
-
-    // Ignore beyond cutoff or identical positions
-    if (r2 >= cutoffDistance2 || r2 < 1e-12)
-    {
-        return 0.0;
-    }
-
-    // Standard LJ formula
-    double inv_r2 = 1.0 / r2;
-    double inv_r6 = inv_r2 * inv_r2 * inv_r2;
-    double inv_r12 = inv_r6 * inv_r6;
-    double u = 4.0 * epsilon * (inv_r12 - inv_r6);
-
-    // Subtract shift
-
-    double u = 4.0 * epsilon * (inv_r12 - inv_r6);
-    return u - u_cut;
-}
\ No newline at end of file
+    return lj_pair_energy(m_coords, other.m_coords, boxSize, epsilon, sigma);
+}
@@ -2,17 +2,66 @@
 #define MOLECULE_H
 
 #include <array>
+#include <cmath>
+
+// Shifted Lennard-Jones energy for a squared distance r2, truncated at
+// 2.5 sigma (zero beyond the cutoff and for coincident particles).
+inline double lj_energy_r2(double r2, double epsilon = 1.0, double sigma = 1.0)
+{
+    // Lennard-Jones cutoff and shift
+    const double cutoffDistance = 2.5 * sigma;
+    const double cutoffDistance2 = cutoffDistance * cutoffDistance;
+    const double sigma2 = sigma * sigma;
+    const double sc2 = sigma2 / cutoffDistance2;
+    const double sc6 = sc2 * sc2 * sc2;
+    const double u_cut = 4.0 * epsilon * (sc6 * sc6 - sc6);
+
+    // Ignore beyond cutoff or identical positions
+    if (r2 >= cutoffDistance2 || r2 < 1e-12)
+    {
+        return 0.0;
+    }
+
+    double sr2 = sigma2 / r2;
+    double sr6 = sr2 * sr2 * sr2;
+    double u = 4.0 * epsilon * (sr6 * sr6 - sr6);
+    return u - u_cut;
+}
+
+// Shifted Lennard-Jones energy between two positions in a periodic box.
+// Shared by Molecule and the cell-list kernels.
+inline double lj_pair_energy(const std::array<double, 3> &a,
+                             const std::array<double, 3> &b,
+                             double boxSize,
+                             double epsilon = 1.0,
+                             double sigma = 1.0)
+{
+    double dx = a[0] - b[0];
+    double dy = a[1] - b[1];
+    double dz = a[2] - b[2];
+
+    // Apply periodic boundary conditions (minimum image)
+    dx -= boxSize * std::round(dx / boxSize);
+    dy -= boxSize * std::round(dy / boxSize);
+    dz -= boxSize * std::round(dz / boxSize);
+
+    return lj_energy_r2(dx * dx + dy * dy + dz * dz, epsilon, sigma);
+}
 
 class Molecule
 {
 public:
     Molecule(int id, double x, double y, double z,
              double vx = 0.0, double vy = 0.0, double vz = 0.0);
-    Molecule(int id, double x, double y, double z, double vx, double vy, double vz);
 
     int get_ID() const;
     const std::array<double, 3> &get_coordinates() const;
     const std::array<double, 3> &get_velocities() const;
+    std::array<double, 3> &get_coordinates();
+    std::array<double, 3> &get_velocities();
+    // Point charge in reduced units (Coulomb energy q_i q_j / r); 0 unless set.
+    double get_charge() const;
+    void set_charge(double q);
 
     double kinetic_energy(double mass = 1.0) const;
 
@@ -21,13 +70,12 @@ public:
                             double boxSize,
                             double epsilon = 1.0,
                             double sigma = 1.0) const;
-    double potential_energy(const Molecule &other, double boxSize, double epsilon = 1.0) const;
 
 private:
     int m_id;
     std::array<double, 3> m_coords;
     std::array<double, 3> m_vels;
+    double m_charge = 0.0;
 };
 
 #endif
-};
@@ -0,0 +1,83 @@
+# Smoke test for the molsim module: make python-check
+import numpy as np
+import molsim
+
+failures = 0
+
+
+def check(name, ok):
+    global failures
+    print(("PASS " if ok else "FAIL ") + name)
+    failures += not ok
+
+
+def raises(f, error):
+    try:
+        f()
+    except error:
+        return True
+    return False
+
+
+box = 20.0
+x = molsim.read_xyz_positions(box, "box20-density0.40-positions.xyz")
+v = molsim.read_xyz_velocities("box20-density0.40-velocities.xyz")
+check("read_xyz shapes", x.shape == v.shape and x.shape[1] == 3)
+
+system = molsim.MolecularSystem.from_arrays(box, x, v)
+check("len", len(system) == len(x))
+direct = system.total_potential_energy()
+cells = system.total_potential_energy_LinkedCells()
+check("LinkedCells energy %.6f matches direct %.6f" % (cells, direct), abs(cells - direct) < 1e-8 * abs(direct))
+check("velocities round trip", np.array_equal(system.velocities, v))
+
+system.reproducible = True
+check("reproducible energy", system.reproducible and abs(system.total_potential_energy_LinkedCells() - cells) < 1e-8 * abs(cells))
+
+# Views write straight into the molecules, and pin the store
+positions = system.positions
+check("view aliases the store", positions.base is not None and not positions.flags.owndata)
+positions[0] += 0.25
+check("write through view changes the energy", system.total_potential_energy() != direct)
+positions[0] -= 0.25
+column = positions[:, 0]
+del positions
+check("add_molecule raises while a slice is alive", raises(lambda: system.add_molecule(-1, 1.0, 1.0, 1.0), RuntimeError))
+del column
+system.add_molecule(len(system), 0.5, 0.5, 0.5)
+check("add_molecule after the views are gone", len(system) == len(x) + 1)
+
+# Growing inside the reserved capacity is fine with a view alive
+grown = molsim.MolecularSystem(box)
+grown.reserve(4)
+view = grown.positions
+grown.add_molecule(0, 1.0, 2.0, 3.0)
+check("add_molecule within reserve() while viewed", len(grown) == 1)
+del view
+
+# Spatial queries need an index that is newer than the last change
+check("query on a missing index raises", raises(lambda: system.query_knn(4), RuntimeError))
+system.update_spatial_index()
+system.add_molecule(len(system), 0.75, 0.75, 0.75)
+check("query on a stale index raises", raises(lambda: system.query_knn(4), RuntimeError))
+# Taking a writable view counts as a change, so copy before indexing
+p = np.array(system.positions)
+system.update_spatial_index()
+
+k = 6
+start, index, distance = system.query_knn(k)
+d = p[:, None, :] - p[None, :, :]
+d -= box * np.round(d / box)
+r = np.sqrt((d * d).sum(axis=2))
+np.fill_diagonal(r, np.inf)
+brute = np.sort(r, axis=1)[:, :k]
+found = np.sort(distance.reshape(len(system), k), axis=1)
+check("knn matches brute force", start[-1] == k * len(system) and np.allclose(found, brute))
+
+start, index, distance = system.query_pairs(1.5)
+check("pairs matches brute force", len(index) == np.count_nonzero(np.triu(r <= 1.5, 1)))
+start, index, distance = system.query_within(np.array([[10.0, 10.0, 10.0]]), 2.0)
+check("within matches brute force", len(index) == np.count_nonzero(
+    np.linalg.norm((p - 10.0 + box / 2) % box - box / 2, axis=1) <= 2.0))
+
+raise SystemExit(1 if failures else 0)
@@ -0,0 +1,164 @@
+#include "neighborlist.h"
+#include "cellgrid.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+NeighborList::NeighborList(double box_size, double cutoff, double skin)
+    : box_size(box_size), cut(cutoff), skin_width(skin)
+{
+}
+
+double NeighborList::cutoff() const
+{
+    return cut;
+}
+
+double NeighborList::skin() const
+{
+    return skin_width;
+}
+
+std::size_t NeighborList::num_pairs() const
+{
+    return list.size();
+}
+
+const numa_vector<std::size_t> &NeighborList::start() const
+{
+    return starts;
+}
+
+const numa_vector<int> &NeighborList::neighbors() const
+{
+    return list;
+}
+
+// One pass over the candidates: each thread collects the rows of its static
+// block of molecules, then copies them into place once the row offsets are
+// known. candidates(i, visit) calls visit(j, x_j) for every j to test.
+template <typename Candidates>
+void NeighborList::fill(const numa_vector<Molecule> &molecules, Candidates candidates)
+{
+    const long n = static_cast<long>(molecules.size());
+    const double rl = cut + skin_width;
+    const double rl2 = rl * rl;
+    const double half = 0.5 * box_size;
+
+    starts.assign(n + 1, 0);
+#pragma omp parallel
+    {
+        // Candidates are written unconditionally and kept by advancing the
+        // count: about one in six is within range, too random to branch on.
+        std::vector<int> rows(1024);
+        std::size_t used = 0;
+        long first = -1;
+#pragma omp for schedule(static)
+        for (long i = 0; i < n; i++)
+        {
+            if (first < 0)
+                first = i;
+            const auto &xi = molecules[i].get_coordinates();
+            const std::size_t before = used;
+            candidates(i, [&](long j, const std::array<double, 3> &xj)
+                       {
+                           double r2 = 0.0;
+                           for (int d = 0; d < 3; d++)
+                           {
+                               double dx = xi[d] - xj[d];
+                               // Positions are at most a skin outside the box
+                               dx += dx < -half ? box_size : (dx > half ? -box_size : 0.0);
+                               r2 += dx * dx;
+                           }
+                           if (used == rows.size())
+                               rows.resize(2 * rows.size());
+                           rows[used] = static_cast<int>(j);
+                           used += (j != i) & (r2 < rl2); });
+            starts[i + 1] = used - before;
+        }
+#pragma omp single
+        {
+            for (long i = 0; i < n; i++)
+            {
+                starts[i + 1] += starts[i];
+            }
+            list.resize(starts[n]);
+        }
+        if (first >= 0)
+            std::copy(rows.begin(), rows.begin() + used, list.begin() + starts[first]);
+    }
+
+    reference.resize(n);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        reference[i] = molecules[i].get_coordinates();
+    }
+}
+
+void NeighborList::build(const numa_vector<Molecule> &molecules)
+{
+    CellGrid grid(box_size, cut + skin_width);
+    const long n = static_cast<long>(molecules.size());
+    if (grid.cells_per_side() < 3)
+    {
+        fill(molecules, [n, &molecules](long, auto visit)
+             {
+                 for (long j = 0; j < n; j++)
+                     visit(j, molecules[j].get_coordinates()); });
+        return;
+    }
+
+    grid.build(molecules);
+    const int n_side = grid.cells_per_side();
+    const auto &cell_start = grid.cell_start();
+    const auto &order = grid.order();
+    const auto &pos = grid.positions();
+    fill(molecules, [&](long i, auto visit)
+         {
+             const int c = grid.cell_of(molecules[i].get_coordinates());
+             const int cx = c % n_side, cy = (c / n_side) % n_side, cz = c / (n_side * n_side);
+             // Full 27-cell stencil: the list holds both directions
+             for (int oz = -1; oz <= 1; oz++)
+                 for (int oy = -1; oy <= 1; oy++)
+                     for (int ox = -1; ox <= 1; ox++)
+                     {
+                         const int nb = (cx + ox + n_side) % n_side +
+                                        ((cy + oy + n_side) % n_side) * n_side +
+                                        ((cz + oz + n_side) % n_side) * n_side * n_side;
+                         for (std::size_t s = cell_start[nb]; s < cell_start[nb + 1]; s++)
+                             visit(static_cast<long>(order[s]), pos[s]);
+                     } });
+}
+
+void NeighborList::build_from(const NeighborList &longer, const numa_vector<Molecule> &molecules)
+{
+    const auto &outer_start = longer.start();
+    const auto &outer_list = longer.neighbors();
+    fill(molecules, [&](long i, auto visit)
+         {
+             for (std::size_t k = outer_start[i]; k < outer_start[i + 1]; k++)
+                 visit(outer_list[k], molecules[outer_list[k]].get_coordinates()); });
+}
+
+bool NeighborList::needs_rebuild(const numa_vector<Molecule> &molecules) const
+{
+    const long n = static_cast<long>(molecules.size());
+    if (static_cast<long>(reference.size()) != n)
+        return true;
+    const double limit2 = 0.25 * skin_width * skin_width;
+    int moved = 0;
+#pragma omp parallel for reduction(| : moved) schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        const auto &x = molecules[i].get_coordinates();
+        double r2 = 0.0;
+        for (int d = 0; d < 3; d++)
+        {
+            const double dx = x[d] - reference[i][d];
+            r2 += dx * dx;
+        }
+        moved |= r2 > limit2;
+    }
+    return moved != 0;
+}
@@ -0,0 +1,44 @@
+// neighborlist.h
+#ifndef NEIGHBORLIST_H
+#define NEIGHBORLIST_H
+
+#include "molecule.h"
+#include "numa.h"
+#include <array>
+#include <cstddef>
+
+// Verlet neighbour list with a skin. Each molecule lists every other molecule
+// (both directions, so force loops can write to i only) within cutoff + skin
+// at build time; the list stays valid until some molecule has moved more
+// than skin / 2 since then.
+class NeighborList
+{
+public:
+    NeighborList(double box_size, double cutoff, double skin);
+
+    // Bin into cells of at least cutoff + skin; all pairs if that gives
+    // fewer than 3 cells per side.
+    void build(const numa_vector<Molecule> &molecules);
+    // Keep the pairs of a longer list that are within this list's range.
+    // The longer list must be valid for the current positions.
+    void build_from(const NeighborList &longer, const numa_vector<Molecule> &molecules);
+    bool needs_rebuild(const numa_vector<Molecule> &molecules) const;
+
+    double cutoff() const;
+    double skin() const;
+    std::size_t num_pairs() const;
+    // Neighbours of i are neighbors()[start()[i] .. start()[i + 1]).
+    const numa_vector<std::size_t> &start() const;
+    const numa_vector<int> &neighbors() const;
+
+private:
+    template <typename Candidates>
+    void fill(const numa_vector<Molecule> &molecules, Candidates candidates);
+
+    double box_size, cut, skin_width;
+    numa_vector<std::size_t> starts;
+    numa_vector<int> list;
+    numa_vector<std::array<double, 3>> reference;
+};
+
+#endif
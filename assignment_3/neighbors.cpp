@@ -0,0 +1,114 @@
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "molecule.h"
+#include "molecularsystem.h"
+#include "spatialindex.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+
+// O(N^2) minimum-image distances from molecule i, for --check
+static std::vector<std::pair<double, int>> brute_force(const numa_vector<Molecule> &molecules, double box_size, std::size_t i)
+{
+    std::vector<std::pair<double, int>> all;
+    const auto &xi = molecules[i].get_coordinates();
+    for (std::size_t j = 0; j < molecules.size(); j++)
+    {
+        if (j == i)
+            continue;
+        const auto &xj = molecules[j].get_coordinates();
+        double r2 = 0.0;
+        for (int d = 0; d < 3; d++)
+        {
+            double dx = xi[d] - xj[d];
+            dx -= box_size * std::round(dx / box_size);
+            r2 += dx * dx;
+        }
+        all.emplace_back(std::sqrt(r2), static_cast<int>(j));
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5 || argc > 6)
+    {
+        std::cerr << "Usage: " << argv[0] << " <box_size> <positions_file> <radius> <k> [--check]\n";
+        return 1;
+    }
+    const double box_size = std::atof(argv[1]);
+    const double radius = std::atof(argv[3]);
+    const int k = std::atoi(argv[4]);
+    const bool check = argc == 6 && std::string(argv[5]) == "--check";
+
+    pin_threads();
+    auto positions = readXYZPositions(box_size, argv[2]);
+    MolecularSystem system(box_size);
+    system.reserve(positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i)
+        system.add_molecule(Molecule(static_cast<int>(i), positions[i][0], positions[i][1], positions[i][2]));
+    const std::size_t n = positions.size();
+
+    try
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        system.update_spatial_index();
+        const std::shared_ptr<const SpatialIndex> index = system.spatial_index();
+        auto t1 = std::chrono::steady_clock::now();
+        SpatialCSR coordination, nearest, half;
+        index->pairs(radius, coordination, false);
+        auto t2 = std::chrono::steady_clock::now();
+        index->knn(k, nearest);
+        auto t3 = std::chrono::steady_clock::now();
+        index->pairs(radius, half);
+        auto t4 = std::chrono::steady_clock::now();
+        auto ms = [](auto a, auto b)
+        { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+        double mean_knn = 0.0;
+        for (std::size_t i = 0; i < n; i++)
+            mean_knn += k > 0 ? nearest.distance[nearest.start[i + 1] - 1] : 0.0;
+        std::cout << "N = " << n << ", index built in " << ms(t0, t1) << " ms\n"
+                  << "Coordination within " << radius << ": " << static_cast<double>(coordination.index.size()) / n
+                  << " (" << ms(t1, t2) << " ms)\n"
+                  << "Mean distance to neighbour " << k << ": " << mean_knn / n << " (" << ms(t2, t3) << " ms)\n"
+                  << "Pairs within " << radius << ": " << half.index.size() << " (" << ms(t3, t4) << " ms)\n";
+
+        if (check)
+        {
+            long mismatches = 0;
+            const std::size_t stride = std::max<std::size_t>(1, n / 200);
+            for (std::size_t i = 0; i < n; i += stride)
+            {
+                const auto all = brute_force(system.get_molecules(), box_size, i);
+                std::vector<int> expected;
+                for (const auto &h : all)
+                    if (h.first <= radius)
+                        expected.push_back(h.second);
+                std::sort(expected.begin(), expected.end());
+                std::vector<int> got(coordination.index.begin() + coordination.start[i],
+                                     coordination.index.begin() + coordination.start[i + 1]);
+                mismatches += got != expected;
+                for (int m = 0; m < k; m++)
+                    mismatches += std::abs(nearest.distance[nearest.start[i] + m] - all[m].first) > 1e-12;
+            }
+            std::cout << "Checked every " << stride << "th molecule against O(N^2): " << mismatches << " mismatches\n";
+            return mismatches ? 1 : 0;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include "numa.h"
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <omp.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Below this size malloc'd memory is fine: it fits in a few pages anyway.
+static const std::size_t mmap_threshold = 1 << 20;
+
+void *numa_allocate(std::size_t bytes)
+{
+    if (bytes < mmap_threshold)
+    {
+        return ::operator new(bytes);
+    }
+
+    // mmap guarantees pages that no thread has touched yet; malloc may hand
+    // back heap pages already resident on whichever node used them last.
+    void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+
+    // First touch with the same static schedule the compute loops use.
+    char *bytes_ptr = static_cast<char *>(ptr);
+    const long page = sysconf(_SC_PAGESIZE);
+    const long num_pages = static_cast<long>((bytes + page - 1) / page);
+#pragma omp parallel for schedule(static) if (!omp_in_parallel())
+    for (long p = 0; p < num_pages; p++)
+    {
+        bytes_ptr[p * page] = 0;
+    }
+    return ptr;
+}
+
+void numa_deallocate(void *ptr, std::size_t bytes)
+{
+    if (bytes < mmap_threshold)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+    munmap(ptr, bytes);
+}
+
+#ifdef __linux__
+// Process affinity mask as it was before pin_threads narrowed it
+static cpu_set_t allowed;
+static bool have_allowed = false;
+#endif
+
+#ifdef __linux__
+// Small integer from a sysfs file, or -1 if it cannot be read
+static int read_sysfs_int(const std::string &path)
+{
+    std::ifstream in(path);
+    int value = -1;
+    in >> value;
+    return in ? value : -1;
+}
+
+// NUMA node of a CPU: the cpuN/nodeK link sysfs keeps for it
+static int cpu_node(int cpu)
+{
+    const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+    {
+        return -1;
+    }
+    int node = -1;
+    while (const dirent *entry = readdir(d))
+    {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 && std::isdigit(static_cast<unsigned char>(entry->d_name[4])))
+        {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(d);
+    return node;
+}
+
+// CPUs of a mask in placement order: grouped by NUMA node, then socket,
+// ascending within a group. CPU numbers alone do not give this order; many
+// dual-socket machines alternate them between sockets.
+static std::vector<int> placement_order(const cpu_set_t &mask)
+{
+    struct Place
+    {
+        int node, package, cpu;
+    };
+    std::vector<Place> places;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &mask))
+        {
+            const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            places.push_back({cpu_node(cpu), read_sysfs_int(topology + "physical_package_id"), cpu});
+        }
+    }
+    std::stable_sort(places.begin(), places.end(), [](const Place &a, const Place &b)
+                     { return a.node != b.node ? a.node < b.node : a.package < b.package; });
+    std::vector<int> cpus;
+    for (const Place &p : places)
+    {
+        cpus.push_back(p.cpu);
+    }
+    return cpus;
+}
+#endif
+
+void pin_threads()
+{
+#ifdef __linux__
+    if (std::getenv("OMP_PROC_BIND") || std::getenv("OMP_PLACES"))
+    {
+        return;
+    }
+
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return;
+    }
+    have_allowed = true;
+    const std::vector<int> cpus = placement_order(allowed);
+    if (cpus.empty())
+    {
+        return;
+    }
+
+    // Compact placement: thread t gets the t-th CPU in placement order, so
+    // neighbouring threads share a node.
+#pragma omp parallel
+    {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &mask);
+        pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    }
+#endif
+}
+
+void pin_worker(int t)
+{
+#ifdef __linux__
+    if (std::getenv("OMP_PROC_BIND") || std::getenv("OMP_PLACES"))
+    {
+        return;
+    }
+    // The process mask as pin_threads saw it, else this thread's own
+    cpu_set_t mask;
+    if (have_allowed)
+    {
+        mask = allowed;
+    }
+    else if (sched_getaffinity(0, sizeof(mask), &mask) != 0)
+    {
+        return;
+    }
+    const std::vector<int> cpus = placement_order(mask);
+    if (cpus.empty())
+    {
+        return;
+    }
+    CPU_ZERO(&mask);
+    CPU_SET(cpus[t % cpus.size()], &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+#else
+    (void)t;
+#endif
+}
+
+void unpin_thread()
+{
+#ifdef __linux__
+    if (have_allowed)
+    {
+        pthread_setaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+    }
+#endif
+}
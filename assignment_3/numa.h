@@ -0,0 +1,59 @@
+// numa.h
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Backing storage for large arrays. Fresh pages are mapped untouched and then
+// first-touched by the OpenMP team with a static schedule, so each thread's
+// share of the array lands on its own NUMA node.
+void *numa_allocate(std::size_t bytes);
+void numa_deallocate(void *ptr, std::size_t bytes);
+
+// Pin each OpenMP thread to one CPU of the process affinity mask, taking the
+// CPUs node by node (then socket by socket) as sysfs reports them, so
+// consecutive threads (and the static cell blocks they own) share a node.
+// Does nothing if the user already set OMP_PROC_BIND or OMP_PLACES.
+void pin_threads();
+
+// Give the calling thread the process-wide affinity mask back. Threads
+// started by a pinned thread inherit its single CPU; helper threads that are
+// not part of the OpenMP team (e.g. file readers) should call this first.
+void unpin_thread();
+
+// Pin the calling thread to the t-th CPU of the process mask in that order,
+// the place pin_threads gives OpenMP thread t. For worker pools used instead
+// of the OpenMP team.
+void pin_worker(int t);
+
+template <typename T>
+struct first_touch_allocator
+{
+    using value_type = T;
+
+    first_touch_allocator() = default;
+    template <typename U>
+    first_touch_allocator(const first_touch_allocator<U> &) {}
+
+    T *allocate(std::size_t n)
+    {
+        return static_cast<T *>(numa_allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n)
+    {
+        numa_deallocate(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const first_touch_allocator<T> &, const first_touch_allocator<U> &) { return true; }
+template <typename T, typename U>
+bool operator!=(const first_touch_allocator<T> &, const first_touch_allocator<U> &) { return false; }
+
+template <typename T>
+using numa_vector = std::vector<T, first_touch_allocator<T>>;
+
+#endif
@@ -0,0 +1,87 @@
+#include "partition.h"
+#include <algorithm>
+
+std::vector<double> cell_costs(const CellGrid &grid)
+{
+    const int n_cells = grid.num_cells();
+    const auto &start = grid.cell_start();
+    std::vector<double> costs(n_cells);
+
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < n_cells; c++)
+    {
+        double n_c = static_cast<double>(start[c + 1] - start[c]);
+        double n_nb = 0.0;
+        for (int neighbor : grid.half_stencil(c))
+        {
+            n_nb += static_cast<double>(start[neighbor + 1] - start[neighbor]);
+        }
+        costs[c] = 0.5 * n_c * (n_c - 1.0) + n_c * n_nb;
+    }
+    return costs;
+}
+
+std::vector<CellChunk> partition_cells(const CellGrid &grid, int num_chunks)
+{
+    const int n_cells = grid.num_cells();
+    const auto &start = grid.cell_start();
+    const std::vector<double> costs = cell_costs(grid);
+
+    double total = 0.0;
+    for (double w : costs)
+    {
+        total += w;
+    }
+    std::vector<CellChunk> chunks;
+    if (total <= 0.0 || num_chunks <= 1)
+    {
+        chunks.push_back({0, n_cells, start[0], start[n_cells]});
+        return chunks;
+    }
+    const double target = total / num_chunks;
+
+    int chunk_cell = 0;
+    double acc = 0.0;
+    for (int c = 0; c < n_cells; c++)
+    {
+        if (costs[c] <= target)
+        {
+            acc += costs[c];
+            if (acc >= target)
+            {
+                chunks.push_back({chunk_cell, c + 1, start[chunk_cell], start[c + 1]});
+                chunk_cell = c + 1;
+                acc = 0.0;
+            }
+            continue;
+        }
+
+        // Hot cell: flush what we have, then cut its rows into pieces.
+        if (chunk_cell < c)
+        {
+            chunks.push_back({chunk_cell, c, start[chunk_cell], start[c]});
+        }
+        const std::size_t n_c = start[c + 1] - start[c];
+        const double n_nb = costs[c] / n_c - 0.5 * (n_c - 1.0);
+        std::size_t piece_begin = start[c];
+        double row_acc = 0.0;
+        for (std::size_t r = 0; r < n_c; r++)
+        {
+            // Row r pairs with the n_c - 1 - r later rows and all neighbours.
+            row_acc += static_cast<double>(n_c - 1 - r) + n_nb;
+            if (row_acc >= target || r + 1 == n_c)
+            {
+                chunks.push_back({c, c + 1, piece_begin, start[c] + r + 1});
+                piece_begin = start[c] + r + 1;
+                row_acc = 0.0;
+            }
+        }
+        chunk_cell = c + 1;
+        acc = 0.0;
+    }
+    if (chunk_cell < n_cells)
+    {
+        chunks.push_back({chunk_cell, n_cells, start[chunk_cell], start[n_cells]});
+    }
+    return chunks;
+}
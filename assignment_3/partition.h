@@ -0,0 +1,26 @@
+// partition.h
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "cellgrid.h"
+#include <cstddef>
+#include <vector>
+
+// A contiguous run of cells in grid order, restricted to the i-particles in
+// slots [slot_begin, slot_end). A dense cell can be cut across several chunks.
+struct CellChunk
+{
+    int cell_begin, cell_end;
+    std::size_t slot_begin, slot_end;
+};
+
+// Estimated pair work of a cell: n_c (n_c - 1) / 2 + n_c * sum of n over its
+// half stencil.
+std::vector<double> cell_costs(const CellGrid &grid);
+
+// Split the grid into about num_chunks chunks of equal estimated cost.
+// Chunks stay in cell order, so a static schedule over them still gives each
+// thread one spatially contiguous block.
+std::vector<CellChunk> partition_cells(const CellGrid &grid, int num_chunks);
+
+#endif
@@ -0,0 +1,223 @@
+#include "perfcounters.h"
+#include "molecularsystem.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <omp.h>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int open_event(PerfEvent e)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (e)
+    {
+    case PerfCycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PerfInstructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PerfL1DMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case PerfLLCMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    default:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+    // User space only, so perf_event_paranoid <= 2 suffices. Counters are
+    // multiplexed if the PMU runs out; the times let read_all scale them.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+}
+#endif
+
+static const char *event_names[NumPerfEvents] = {"cycles", "instructions", "L1D misses", "LLC misses",
+                                                 "branch misses"};
+
+PerfCounters::PerfCounters()
+{
+    fds.resize(omp_get_max_threads());
+    for (auto &f : fds)
+        f.fill(-1);
+#ifdef __linux__
+#pragma omp parallel
+    {
+        // Each thread opens counters on itself
+        auto &mine = fds[omp_get_thread_num()];
+        for (int e = 0; e < NumPerfEvents; e++)
+            mine[e] = open_event(static_cast<PerfEvent>(e));
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for (const auto &f : fds)
+        for (int fd : f)
+            if (fd >= 0)
+                close(fd);
+#endif
+}
+
+bool PerfCounters::available() const
+{
+    for (const auto &f : fds)
+        for (int fd : f)
+            if (fd >= 0)
+                return true;
+    return false;
+}
+
+std::vector<PerfCounters::Counts> PerfCounters::read_all() const
+{
+    std::vector<Counts> counts(fds.size());
+    for (std::size_t t = 0; t < fds.size(); t++)
+    {
+        counts[t].fill(0.0);
+#ifdef __linux__
+        for (int e = 0; e < NumPerfEvents; e++)
+        {
+            std::uint64_t v[3];
+            if (fds[t][e] >= 0 && read(fds[t][e], v, sizeof(v)) == sizeof(v) && v[2] > 0)
+                counts[t][e] = static_cast<double>(v[0]) * v[1] / v[2];
+        }
+#endif
+    }
+    return counts;
+}
+
+void PerfCounters::begin(const std::string &phase)
+{
+    if (!totals.count(phase))
+    {
+        order.push_back(phase);
+        totals[phase].assign(fds.size(), Counts{});
+    }
+    open_phase[phase] = read_all();
+}
+
+void PerfCounters::end(const std::string &phase)
+{
+    auto it = open_phase.find(phase);
+    if (it == open_phase.end())
+        return;
+    const std::vector<Counts> now = read_all();
+    auto &total = totals[phase];
+    for (std::size_t t = 0; t < fds.size(); t++)
+        for (int e = 0; e < NumPerfEvents; e++)
+            total[t][e] += now[t][e] - it->second[t][e];
+    open_phase.erase(it);
+}
+
+void PerfCounters::set_pairs(const std::string &phase, double n)
+{
+    pairs[phase] = n;
+}
+
+PerfCounters::Counts PerfCounters::sum(const std::string &phase) const
+{
+    Counts total{};
+    auto it = totals.find(phase);
+    if (it != totals.end())
+        for (const Counts &c : it->second)
+            for (int e = 0; e < NumPerfEvents; e++)
+                total[e] += c[e];
+    return total;
+}
+
+double PerfCounters::ipc(const std::string &phase) const
+{
+    const Counts c = sum(phase);
+    return c[PerfCycles] > 0 ? c[PerfInstructions] / c[PerfCycles] : 0.0;
+}
+
+double PerfCounters::bytes_per_pair(const std::string &phase) const
+{
+    auto p = pairs.find(phase);
+    return p != pairs.end() && p->second > 0 ? 64.0 * sum(phase)[PerfLLCMisses] / p->second : 0.0;
+}
+
+void PerfCounters::report(std::ostream &os) const
+{
+    if (!available())
+    {
+        os << "Hardware counters unavailable (no PMU access; check /proc/sys/kernel/perf_event_paranoid).\n";
+        return;
+    }
+    for (int e = 0; e < NumPerfEvents; e++)
+    {
+        if (std::none_of(fds.begin(), fds.end(), [e](const auto &f) { return f[e] >= 0; }))
+            os << "Note: " << event_names[e] << " not available on this CPU.\n";
+    }
+
+    char line[256];
+    for (const std::string &phase : order)
+    {
+        const auto &per_thread = totals.at(phase);
+        const auto p = pairs.find(phase);
+        os << "Phase " << phase << ":\n";
+        std::snprintf(line, sizeof(line), "  %6s %14s %14s %6s %12s %12s %12s%s\n", "thread", "cycles",
+                      "instructions", "IPC", "L1D miss", "LLC miss", "br miss",
+                      p != pairs.end() ? "  bytes/pair" : "");
+        os << line;
+        Counts all{};
+        auto print_row = [&](const char *label, const Counts &c)
+        {
+            std::snprintf(line, sizeof(line), "  %6s %14.0f %14.0f %6.2f %12.0f %12.0f %12.0f", label,
+                          c[PerfCycles], c[PerfInstructions],
+                          c[PerfCycles] > 0 ? c[PerfInstructions] / c[PerfCycles] : 0.0,
+                          c[PerfL1DMisses], c[PerfLLCMisses], c[PerfBranchMisses]);
+            os << line;
+        };
+        for (std::size_t t = 0; t < per_thread.size(); t++)
+        {
+            print_row(std::to_string(t).c_str(), per_thread[t]);
+            os << "\n";
+            for (int e = 0; e < NumPerfEvents; e++)
+                all[e] += per_thread[t][e];
+        }
+        print_row("all", all);
+        if (p != pairs.end() && p->second > 0)
+        {
+            std::snprintf(line, sizeof(line), "  %11.3f", bytes_per_pair(phase));
+            os << line;
+        }
+        os << "\n";
+    }
+}
+
+// Profiled linked-cell pass; defined here so that only binaries that profile
+// link the counters.
+double MolecularSystem::total_potential_energy_LinkedCells(PerfCounters *perf) const
+{
+    if (!perf)
+        return linked_cells_energy(Phases{});
+    Phases phases;
+    phases.begin = [perf](const char *phase)
+    { perf->begin(phase); };
+    phases.end = [perf](const char *phase)
+    { perf->end(phase); };
+    phases.pairs = [perf](double pairs)
+    { perf->set_pairs("pairs", pairs); };
+    return linked_cells_energy(phases);
+}
@@ -0,0 +1,66 @@
+// perfcounters.h
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <array>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum PerfEvent
+{
+    PerfCycles,
+    PerfInstructions,
+    PerfL1DMisses,
+    PerfLLCMisses,
+    PerfBranchMisses,
+    NumPerfEvents
+};
+
+// Hardware counters (Linux perf_event_open, user space only) on every thread
+// of the OpenMP team. Phases are bracketed with begin()/end() from serial
+// code; the counts each thread accumulated in between are added to the
+// phase. Counters that cannot be opened (no PMU, perf_event_paranoid, other
+// OS) read as unavailable and the report says so.
+//
+// The OpenMP runtime must keep the same team between construction and the
+// last end(), i.e. do not change the thread count in between.
+class PerfCounters
+{
+public:
+    using Counts = std::array<double, NumPerfEvents>;
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // True if at least one event could be opened.
+    bool available() const;
+
+    void begin(const std::string &phase);
+    void end(const std::string &phase);
+    // Number of pair distance checks done in a phase, for bytes per pair.
+    void set_pairs(const std::string &phase, double pairs);
+
+    // Summed over threads; 0 if the phase or the events are missing.
+    double ipc(const std::string &phase) const;
+    double bytes_per_pair(const std::string &phase) const;
+
+    // Per phase and thread: raw counts, IPC, and for phases with pairs the
+    // LLC traffic per pair (misses * 64 bytes / pairs).
+    void report(std::ostream &os) const;
+
+private:
+    std::vector<Counts> read_all() const;
+    Counts sum(const std::string &phase) const;
+
+    // fds[t][e], -1 if event e is not available on thread t
+    std::vector<std::array<int, NumPerfEvents>> fds;
+    std::vector<std::string> order;
+    std::map<std::string, std::vector<Counts>> open_phase, totals;
+    std::map<std::string, double> pairs;
+};
+
+#endif
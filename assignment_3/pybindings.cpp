@@ -0,0 +1,628 @@
+// Python module "molsim": MolecularSystem with NumPy views on its storage,
+// written against the CPython and NumPy C APIs (no binding library needed).
+//
+//   import molsim
+//   system = molsim.MolecularSystem.from_arrays(20.0, positions, velocities)
+//   system.positions[:, 0] += 0.1   # writes straight into the C++ store
+//   system.total_potential_energy_LinkedCells()
+//   system.update_spatial_index()
+//   start, index, distance = system.query_knn(12)
+//
+// The position/velocity arrays alias the molecule store (strided over
+// Molecule, no copies). Each view, and every array sliced from it, pins the
+// store through a small base object; so does a call running with the GIL
+// released. While the store is pinned, reserve() and add_molecule() raise
+// RuntimeError if they would reallocate it, so no array ever points at
+// freed memory. Taking a view marks the molecules as changed, so call
+// update_spatial_index() again before the next query.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include "molecule.h"
+#include "molecularsystem.h"
+#include "spatialindex.h"
+#include "numa.h"
+#include <cstring>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+std::vector<std::array<double, 3>> readXYZVelocities(const std::string &filename);
+
+namespace
+{
+struct SystemObject
+{
+    PyObject_HEAD
+    MolecularSystem *system;
+    // Live views plus calls running without the GIL; only changed with
+    // the GIL held
+    Py_ssize_t pins;
+};
+
+// Base object of a view: keeps the system alive and pinned
+struct PinObject
+{
+    PyObject_HEAD
+    SystemObject *owner;
+};
+
+// Heap types, created from the specs below when the module is imported
+PyTypeObject *SystemType = nullptr;
+PyTypeObject *PinType = nullptr;
+
+void set_python_error(std::exception_ptr error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::bad_alloc &)
+    {
+        PyErr_NoMemory();
+    }
+    catch (const std::invalid_argument &e)
+    {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    catch (const std::exception &e)
+    {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+}
+
+// Runs f with the GIL released and the store pinned; false (with a Python
+// error set) if it threw.
+template <typename F>
+bool without_gil(SystemObject *self, F f)
+{
+    std::exception_ptr error;
+    self->pins++;
+    Py_BEGIN_ALLOW_THREADS;
+    try
+    {
+        f();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS;
+    self->pins--;
+    if (error)
+    {
+        set_python_error(error);
+        return false;
+    }
+    return true;
+}
+
+// Read-only access; the mutable overload marks the spatial index stale
+const numa_vector<Molecule> &molecules_of(const SystemObject *self)
+{
+    return static_cast<const MolecularSystem *>(self->system)->get_molecules();
+}
+
+// Raises unless growing the store to n molecules keeps it in place.
+bool may_grow(SystemObject *self, std::size_t n)
+{
+    if (self->pins > 0 && n > molecules_of(self).capacity())
+    {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "positions/velocities views (or a running call) still use the molecule store; "
+                        "delete them or reserve() before taking views");
+        return false;
+    }
+    return true;
+}
+
+// N x 3 C-contiguous double array, or null with a Python error set.
+PyArrayObject *as_n_by_3(PyObject *obj, npy_intp n, const char *name)
+{
+    PyArrayObject *a = reinterpret_cast<PyArrayObject *>(
+        PyArray_FROMANY(obj, NPY_DOUBLE, 2, 2, NPY_ARRAY_IN_ARRAY));
+    if (!a)
+        return nullptr;
+    if (PyArray_DIM(a, 1) != 3 || (n >= 0 && PyArray_DIM(a, 0) != n))
+    {
+        Py_DECREF(a);
+        PyErr_Format(PyExc_ValueError, "%s must have shape (N, 3)", name);
+        return nullptr;
+    }
+    return a;
+}
+
+PyObject *vector_array(const std::vector<std::array<double, 3>> &x)
+{
+    npy_intp dims[2] = {static_cast<npy_intp>(x.size()), 3};
+    PyObject *a = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if (a && !x.empty())
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject *>(a)), x.data(), x.size() * sizeof(x[0]));
+    return a;
+}
+
+// (start, index, distance) arrays of a query result
+template <typename T>
+PyObject *copy_array(const numa_vector<T> &v, int type)
+{
+    npy_intp dims[1] = {static_cast<npy_intp>(v.size())};
+    PyObject *a = PyArray_SimpleNew(1, dims, type);
+    if (a && !v.empty())
+        std::memcpy(PyArray_DATA(reinterpret_cast<PyArrayObject *>(a)), v.data(), v.size() * sizeof(T));
+    return a;
+}
+
+PyObject *csr_arrays(const SpatialCSR &csr)
+{
+    static_assert(sizeof(std::size_t) == sizeof(npy_uintp), "start offsets are copied as uintp");
+    PyObject *start = copy_array(csr.start, NPY_UINTP);
+    PyObject *index = copy_array(csr.index, NPY_INT);
+    PyObject *distance = copy_array(csr.distance, NPY_DOUBLE);
+    if (!start || !index || !distance)
+    {
+        Py_XDECREF(start);
+        Py_XDECREF(index);
+        Py_XDECREF(distance);
+        return nullptr;
+    }
+    return Py_BuildValue("(NNN)", start, index, distance);
+}
+
+// --- MolecularSystem -------------------------------------------------------
+
+PyObject *system_new(PyTypeObject *type, PyObject *, PyObject *)
+{
+    SystemObject *self = reinterpret_cast<SystemObject *>(type->tp_alloc(type, 0));
+    if (self)
+    {
+        self->system = nullptr;
+        self->pins = 0;
+    }
+    return reinterpret_cast<PyObject *>(self);
+}
+
+int system_init(SystemObject *self, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"box_size", nullptr};
+    double box_size;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "d", const_cast<char **>(keywords), &box_size))
+        return -1;
+    if (self->pins > 0)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "cannot re-initialise a system with live views");
+        return -1;
+    }
+    try
+    {
+        MolecularSystem *fresh = new MolecularSystem(box_size);
+        delete self->system;
+        self->system = fresh;
+    }
+    catch (...)
+    {
+        set_python_error(std::current_exception());
+        return -1;
+    }
+    return 0;
+}
+
+void system_dealloc(SystemObject *self)
+{
+    delete self->system;
+    PyTypeObject *type = Py_TYPE(self);
+    type->tp_free(reinterpret_cast<PyObject *>(self));
+    Py_DECREF(type);
+}
+
+SystemObject *checked(PyObject *obj)
+{
+    SystemObject *self = reinterpret_cast<SystemObject *>(obj);
+    if (!self->system)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "MolecularSystem.__init__ was not called");
+        return nullptr;
+    }
+    return self;
+}
+
+PyObject *system_from_arrays(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"box_size", "positions", "velocities", nullptr};
+    double box_size;
+    PyObject *pos_obj, *vel_obj = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "dO|O", const_cast<char **>(keywords),
+                                     &box_size, &pos_obj, &vel_obj))
+        return nullptr;
+    PyArrayObject *pos = as_n_by_3(pos_obj, -1, "positions");
+    if (!pos)
+        return nullptr;
+    const npy_intp n = PyArray_DIM(pos, 0);
+    PyArrayObject *vel = nullptr;
+    if (vel_obj != Py_None && !(vel = as_n_by_3(vel_obj, n, "velocities")))
+    {
+        Py_DECREF(pos);
+        return nullptr;
+    }
+
+    SystemObject *self = reinterpret_cast<SystemObject *>(system_new(SystemType, nullptr, nullptr));
+    if (self)
+    {
+        try
+        {
+            self->system = new MolecularSystem(box_size);
+            self->system->reserve(n);
+            const double *p = static_cast<const double *>(PyArray_DATA(pos));
+            const double *v = vel ? static_cast<const double *>(PyArray_DATA(vel)) : nullptr;
+            for (npy_intp i = 0; i < n; i++)
+            {
+                self->system->add_molecule(Molecule(static_cast<int>(i), p[3 * i], p[3 * i + 1], p[3 * i + 2],
+                                                    v ? v[3 * i] : 0.0, v ? v[3 * i + 1] : 0.0,
+                                                    v ? v[3 * i + 2] : 0.0));
+            }
+        }
+        catch (...)
+        {
+            set_python_error(std::current_exception());
+            Py_CLEAR(self);
+        }
+    }
+    Py_DECREF(pos);
+    Py_XDECREF(vel);
+    return reinterpret_cast<PyObject *>(self);
+}
+
+PyObject *system_reserve(PyObject *obj, PyObject *args)
+{
+    SystemObject *self = checked(obj);
+    Py_ssize_t n;
+    if (!self || !PyArg_ParseTuple(args, "n", &n))
+        return nullptr;
+    if (n < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "n must not be negative");
+        return nullptr;
+    }
+    if (!may_grow(self, static_cast<std::size_t>(n)))
+        return nullptr;
+    try
+    {
+        self->system->reserve(static_cast<std::size_t>(n));
+    }
+    catch (...)
+    {
+        set_python_error(std::current_exception());
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *system_add_molecule(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"id", "x", "y", "z", "vx", "vy", "vz", nullptr};
+    SystemObject *self = checked(obj);
+    int id;
+    double x, y, z, vx = 0.0, vy = 0.0, vz = 0.0;
+    if (!self || !PyArg_ParseTupleAndKeywords(args, kwargs, "iddd|ddd", const_cast<char **>(keywords),
+                                              &id, &x, &y, &z, &vx, &vy, &vz))
+        return nullptr;
+    if (!may_grow(self, molecules_of(self).size() + 1))
+        return nullptr;
+    try
+    {
+        self->system->add_molecule(Molecule(id, x, y, z, vx, vy, vz));
+    }
+    catch (...)
+    {
+        set_python_error(std::current_exception());
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+Py_ssize_t system_len(PyObject *obj)
+{
+    SystemObject *self = checked(obj);
+    return self ? static_cast<Py_ssize_t>(molecules_of(self).size()) : -1;
+}
+
+// N x 3 view onto either the coordinates or the velocities of every molecule
+PyObject *molecule_view(SystemObject *self, bool velocities)
+{
+    auto &molecules = self->system->get_molecules();
+    npy_intp dims[2] = {static_cast<npy_intp>(molecules.size()), 3};
+    if (molecules.empty())
+        return PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    npy_intp strides[2] = {static_cast<npy_intp>(sizeof(Molecule)), static_cast<npy_intp>(sizeof(double))};
+    double *first = velocities ? molecules[0].get_velocities().data() : molecules[0].get_coordinates().data();
+    PyObject *view = PyArray_New(&PyArray_Type, 2, dims, NPY_DOUBLE, strides, first, 0,
+                                 NPY_ARRAY_WRITEABLE | NPY_ARRAY_ALIGNED, nullptr);
+    if (!view)
+        return nullptr;
+    PinObject *pin = PyObject_New(PinObject, PinType);
+    if (!pin)
+    {
+        Py_DECREF(view);
+        return nullptr;
+    }
+    Py_INCREF(self);
+    pin->owner = self;
+    self->pins++;
+    // Steals the pin; slices of the view keep it as their base too
+    if (PyArray_SetBaseObject(reinterpret_cast<PyArrayObject *>(view), reinterpret_cast<PyObject *>(pin)) < 0)
+    {
+        Py_DECREF(view);
+        return nullptr;
+    }
+    return view;
+}
+
+PyObject *system_positions(PyObject *obj, void *)
+{
+    SystemObject *self = checked(obj);
+    return self ? molecule_view(self, false) : nullptr;
+}
+
+PyObject *system_velocities(PyObject *obj, void *)
+{
+    SystemObject *self = checked(obj);
+    return self ? molecule_view(self, true) : nullptr;
+}
+
+PyObject *system_box_size(PyObject *obj, void *)
+{
+    SystemObject *self = checked(obj);
+    return self ? PyFloat_FromDouble(self->system->get_box_size()) : nullptr;
+}
+
+PyObject *system_get_reproducible(PyObject *obj, void *)
+{
+    SystemObject *self = checked(obj);
+    return self ? PyBool_FromLong(self->system->reproducible()) : nullptr;
+}
+
+int system_set_reproducible(PyObject *obj, PyObject *value, void *)
+{
+    SystemObject *self = checked(obj);
+    if (!self)
+        return -1;
+    if (!value)
+    {
+        PyErr_SetString(PyExc_TypeError, "cannot delete reproducible");
+        return -1;
+    }
+    const int on = PyObject_IsTrue(value);
+    if (on < 0)
+        return -1;
+    self->system->set_reproducible(on != 0);
+    return 0;
+}
+
+// Energy method of the system, evaluated with the GIL released
+template <double (MolecularSystem::*Energy)() const>
+PyObject *system_energy(PyObject *obj, PyObject *)
+{
+    SystemObject *self = checked(obj);
+    if (!self)
+        return nullptr;
+    double energy = 0.0;
+    if (!without_gil(self, [&]
+                     { energy = (self->system->*Energy)(); }))
+        return nullptr;
+    return PyFloat_FromDouble(energy);
+}
+
+PyObject *system_update_spatial_index(PyObject *obj, PyObject *)
+{
+    SystemObject *self = checked(obj);
+    if (!self || !without_gil(self, [self]
+                              { self->system->update_spatial_index(); }))
+        return nullptr;
+    Py_RETURN_NONE;
+}
+
+PyObject *system_query_within(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"points", "r", nullptr};
+    SystemObject *self = checked(obj);
+    PyObject *points_obj;
+    double r;
+    if (!self || !PyArg_ParseTupleAndKeywords(args, kwargs, "Od", const_cast<char **>(keywords), &points_obj, &r))
+        return nullptr;
+    PyArrayObject *points = as_n_by_3(points_obj, -1, "points");
+    if (!points)
+        return nullptr;
+    std::vector<std::array<double, 3>> q(PyArray_DIM(points, 0));
+    std::memcpy(q.data(), PyArray_DATA(points), q.size() * sizeof(q[0]));
+    Py_DECREF(points);
+    SpatialCSR out;
+    if (!without_gil(self, [&]
+                     { self->system->spatial_index()->within(q, r, out); }))
+        return nullptr;
+    return csr_arrays(out);
+}
+
+PyObject *system_query_pairs(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"r", "each_pair_once", nullptr};
+    SystemObject *self = checked(obj);
+    double r;
+    int each_pair_once = 1;
+    if (!self || !PyArg_ParseTupleAndKeywords(args, kwargs, "d|p", const_cast<char **>(keywords), &r, &each_pair_once))
+        return nullptr;
+    SpatialCSR out;
+    if (!without_gil(self, [&]
+                     { self->system->spatial_index()->pairs(r, out, each_pair_once != 0); }))
+        return nullptr;
+    return csr_arrays(out);
+}
+
+PyObject *system_query_knn(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"k", nullptr};
+    SystemObject *self = checked(obj);
+    int k;
+    if (!self || !PyArg_ParseTupleAndKeywords(args, kwargs, "i", const_cast<char **>(keywords), &k))
+        return nullptr;
+    SpatialCSR out;
+    if (!without_gil(self, [&]
+                     { self->system->spatial_index()->knn(k, out); }))
+        return nullptr;
+    return csr_arrays(out);
+}
+
+PyMethodDef system_methods[] = {
+    {"from_arrays", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(system_from_arrays)),
+     METH_VARARGS | METH_KEYWORDS | METH_STATIC,
+     "from_arrays(box_size, positions, velocities=None): system from (N, 3) arrays"},
+    {"reserve", system_reserve, METH_VARARGS,
+     "reserve(n): allocate (and NUMA first-touch) storage for n molecules"},
+    {"add_molecule", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(system_add_molecule)),
+     METH_VARARGS | METH_KEYWORDS, "add_molecule(id, x, y, z, vx=0, vy=0, vz=0)"},
+    {"total_kinetic_energy", system_energy<&MolecularSystem::total_kinetic_energy>, METH_NOARGS, nullptr},
+    {"total_potential_energy", system_energy<&MolecularSystem::total_potential_energy>, METH_NOARGS, nullptr},
+    {"total_potential_energy_LinkedCells",
+     system_energy<static_cast<double (MolecularSystem::*)() const>(&MolecularSystem::total_potential_energy_LinkedCells)>,
+     METH_NOARGS, nullptr},
+    {"total_energy", system_energy<&MolecularSystem::total_energy>, METH_NOARGS, nullptr},
+    // Spatial queries; results are (start, index, distance) CSR arrays
+    {"update_spatial_index", system_update_spatial_index, METH_NOARGS,
+     "(Re)build the spatial index; needed after any change of the molecules"},
+    {"query_within", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(system_query_within)),
+     METH_VARARGS | METH_KEYWORDS, "query_within(points, r): molecules within r of each point"},
+    {"query_pairs", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(system_query_pairs)),
+     METH_VARARGS | METH_KEYWORDS, "query_pairs(r, each_pair_once=True): neighbours within r"},
+    {"query_knn", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(system_query_knn)),
+     METH_VARARGS | METH_KEYWORDS, "query_knn(k): k nearest neighbours of each molecule"},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef system_getset[] = {
+    {"positions", system_positions, nullptr, "(N, 3) view of the coordinates", nullptr},
+    {"velocities", system_velocities, nullptr, "(N, 3) view of the velocities", nullptr},
+    {"box_size", system_box_size, nullptr, nullptr, nullptr},
+    {"reproducible", system_get_reproducible, system_set_reproducible,
+     "thread-count independent energy sums", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+void pin_dealloc(PinObject *self)
+{
+    self->owner->pins--;
+    Py_DECREF(self->owner);
+    PyTypeObject *type = Py_TYPE(self);
+    PyObject_Free(self);
+    Py_DECREF(type);
+}
+
+// --- module ----------------------------------------------------------------
+
+PyObject *module_pin_threads(PyObject *, PyObject *)
+{
+    pin_threads();
+    Py_RETURN_NONE;
+}
+
+PyObject *module_read_xyz_positions(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"box_size", "filename", nullptr};
+    double box_size;
+    const char *filename;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ds", const_cast<char **>(keywords), &box_size, &filename))
+        return nullptr;
+    std::vector<std::array<double, 3>> x;
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS;
+    try
+    {
+        x = readXYZPositions(box_size, filename);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS;
+    if (error)
+    {
+        set_python_error(error);
+        return nullptr;
+    }
+    return vector_array(x);
+}
+
+PyObject *module_read_xyz_velocities(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    static const char *keywords[] = {"filename", nullptr};
+    const char *filename;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s", const_cast<char **>(keywords), &filename))
+        return nullptr;
+    std::vector<std::array<double, 3>> v;
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS;
+    try
+    {
+        v = readXYZVelocities(filename);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS;
+    if (error)
+    {
+        set_python_error(error);
+        return nullptr;
+    }
+    return vector_array(v);
+}
+
+PyMethodDef module_methods[] = {
+    {"pin_threads", module_pin_threads, METH_NOARGS, "Pin OpenMP threads compactly"},
+    {"read_xyz_positions", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(module_read_xyz_positions)),
+     METH_VARARGS | METH_KEYWORDS, "read_xyz_positions(box_size, filename) -> (N, 3) array"},
+    {"read_xyz_velocities", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(module_read_xyz_velocities)),
+     METH_VARARGS | METH_KEYWORDS, "read_xyz_velocities(filename) -> (N, 3) array"},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef module_def = {PyModuleDef_HEAD_INIT, "molsim",
+                          "Lennard-Jones MolecularSystem with zero-copy NumPy views", -1, module_methods,
+                          nullptr, nullptr, nullptr, nullptr};
+} // namespace
+
+PyMODINIT_FUNC PyInit_molsim()
+{
+    import_array();
+
+    PyType_Slot system_slots[] = {
+        {Py_tp_doc, const_cast<char *>("MolecularSystem(box_size)")},
+        {Py_tp_new, reinterpret_cast<void *>(system_new)},
+        {Py_tp_init, reinterpret_cast<void *>(system_init)},
+        {Py_tp_dealloc, reinterpret_cast<void *>(system_dealloc)},
+        {Py_tp_methods, system_methods},
+        {Py_tp_getset, system_getset},
+        {Py_sq_length, reinterpret_cast<void *>(system_len)},
+        {0, nullptr}};
+    PyType_Spec system_spec = {"molsim.MolecularSystem", sizeof(SystemObject), 0, Py_TPFLAGS_DEFAULT, system_slots};
+    PyType_Slot pin_slots[] = {
+        {Py_tp_dealloc, reinterpret_cast<void *>(pin_dealloc)},
+        {0, nullptr}};
+    PyType_Spec pin_spec = {"molsim._ViewPin", sizeof(PinObject), 0, Py_TPFLAGS_DEFAULT, pin_slots};
+
+    SystemType = reinterpret_cast<PyTypeObject *>(PyType_FromSpec(&system_spec));
+    PinType = reinterpret_cast<PyTypeObject *>(PyType_FromSpec(&pin_spec));
+    if (!SystemType || !PinType)
+        return nullptr;
+    PyObject *m = PyModule_Create(&module_def);
+    if (!m)
+        return nullptr;
+    Py_INCREF(SystemType);
+    if (PyModule_AddObject(m, "MolecularSystem", reinterpret_cast<PyObject *>(SystemType)) < 0)
+    {
+        Py_DECREF(SystemType);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}
@@ -5,9 +5,37 @@
 #include <array>
 #include <string>
 #include <cmath>
+#include <stdexcept>
+#include "trajectory.h"
 
+std::vector<std::array<double, 3>> readTrajectoryFrame(double a, const std::string &filename, std::size_t frame)
+{
+    try
+    {
+        TrajectoryReader reader(filename);
+        if (std::abs(reader.box_size() - a) > 1e-9 * a)
+            std::cerr << "Warning: " << filename << " was written for box " << reader.box_size() << "\n";
+        auto data = reader.read_frame(frame);
+        for (auto &p : data)
+        {
+            for (double &x : p)
+                x = fmod(x + a, a);
+        }
+        return data;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Could not read " << filename << ": " << e.what() << "\n";
+        return {};
+    }
+}
+
+// Text XYZ, or the first frame of a compressed trajectory.
 std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename)
 {
+    if (is_trajectory_file(filename))
+        return readTrajectoryFrame(a, filename, 0);
+
     std::ifstream file(filename);
     if (!file.is_open())
     {
@@ -21,18 +49,6 @@ std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string
     {
         std::istringstream iss(line);
         iss >> numAtoms;
-        std::cerr << "Could not open file: " << filename << std::endl;
-        return {};
-    }
-
-    std::vector<std::array<double, 3>> data;
-    std::size_t numAtoms = 0;
-
-    // Read the first line to get the number of atoms
-    std::string line;
-    if (std::getline(file, line))
-    {
-        std::istringstream(line) >> numAtoms;
     }
     std::getline(file, line);
     std::string atom;
@@ -54,7 +70,8 @@ std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string
     return data;
 }
 
-std::vector<std::array<double, 3>> readXYZVelocities(const std::string &filename)
+// Charges from an optional fifth column; 0 where it is missing.
+std::vector<double> readXYZCharges(const std::string &filename)
 {
     std::ifstream file(filename);
     if (!file.is_open())
@@ -62,7 +79,7 @@ std::vector<std::array<double, 3>> readXYZVelocities(const std::string &filename
         std::cerr << "Could not open file: " << filename << "\n";
         return {};
     }
-    std::vector<std::array<double, 3>> data;
+    std::vector<double> data;
     std::size_t numAtoms = 0;
     std::string line;
     if (std::getline(file, line))
@@ -72,37 +89,48 @@ std::vector<std::array<double, 3>> readXYZVelocities(const std::string &filename
     }
     std::getline(file, line);
     std::string atom;
-    double vx, vy, vz;
+    double x, y, z, q;
     while (std::getline(file, line) && data.size() < numAtoms)
     {
         std::istringstream iss(line);
-        if (iss >> atom >> vx >> vy >> vz)
+        if (iss >> atom >> x >> y >> z)
         {
-            data.push_back({vx, vy, vz});
+            data.push_back(iss >> q ? q : 0.0);
         }
     }
     if (data.size() != numAtoms)
         std::cerr << "Warning: Expected " << numAtoms << " atoms, but read " << data.size() << "\n";
-    // Skip the second line
-    std::getline(file, line);
+    return data;
+}
 
-    // Read atom data
-    std::string atomType;
-    double x, y, z;
+std::vector<std::array<double, 3>> readXYZVelocities(const std::string &filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Could not open file: " << filename << "\n";
+        return {};
+    }
+    std::vector<std::array<double, 3>> data;
+    std::size_t numAtoms = 0;
+    std::string line;
+    if (std::getline(file, line))
+    {
+        std::istringstream iss(line);
+        iss >> numAtoms;
+    }
+    std::getline(file, line);
+    std::string atom;
+    double vx, vy, vz;
     while (std::getline(file, line) && data.size() < numAtoms)
     {
         std::istringstream iss(line);
-        if (iss >> atomType >> x >> y >> z)
+        if (iss >> atom >> vx >> vy >> vz)
         {
-            data.push_back({x, y, z});
+            data.push_back({vx, vy, vz});
         }
     }
-
     if (data.size() != numAtoms)
-    {
-        std::cerr << "Warning: Expected " << numAtoms
-                  << " atoms, but read " << data.size() << std::endl;
-    }
-
+        std::cerr << "Warning: Expected " << numAtoms << " atoms, but read " << data.size() << "\n";
     return data;
 }
@@ -0,0 +1,27 @@
+#include "reduction.h"
+#include <algorithm>
+#include <vector>
+
+double reproducible_sum(const numa_vector<double> &terms)
+{
+    const long block = 1024;
+    const long n = static_cast<long>(terms.size());
+    const long n_blocks = (n + block - 1) / block;
+    std::vector<double> sums(n_blocks, 0.0);
+#pragma omp parallel for schedule(static)
+    for (long b = 0; b < n_blocks; b++)
+    {
+        double s = 0.0;
+        const long end = std::min(n, (b + 1) * block);
+        for (long i = b * block; i < end; i++)
+            s += terms[i];
+        sums[b] = s;
+    }
+    // Pairwise tree: level by level, neighbours are added in place
+    for (long width = 1; width < n_blocks; width *= 2)
+    {
+        for (long b = 0; b + width < n_blocks; b += 2 * width)
+            sums[b] += sums[b + width];
+    }
+    return n_blocks ? sums[0] : 0.0;
+}
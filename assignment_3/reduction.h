@@ -0,0 +1,13 @@
+// reduction.h
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#include "numa.h"
+
+// Sum whose rounding does not depend on the number of threads or on the
+// schedule: terms are added in fixed blocks (each block in index order,
+// blocks in parallel), then the block sums are combined by a fixed pairwise
+// tree. The same terms give the same bits on any thread count.
+double reproducible_sum(const numa_vector<double> &terms);
+
+#endif
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "molecule.h"
+#include "molecularsystem.h"
+#include "replicaexchange.h"
+#include "workpool.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    ReplicaOptions options;
+    int workers = static_cast<int>(std::thread::hardware_concurrency());
+    for (int k = 1; k < argc; k++)
+    {
+        const std::string arg = argv[k];
+        if (arg == "--segments" && k + 1 < argc)
+            options.segments = std::atoi(argv[++k]);
+        else if (arg == "--interval" && k + 1 < argc)
+            options.exchange_interval = std::atoi(argv[++k]);
+        else if (arg == "--workers" && k + 1 < argc)
+            workers = std::atoi(argv[++k]);
+        else if (arg == "--dt" && k + 1 < argc)
+            options.md.dt = std::atof(argv[++k]);
+        else if (arg == "--out" && k + 1 < argc)
+            options.output_prefix = argv[++k];
+        else
+            args.push_back(arg);
+    }
+    if (args.size() != 5)
+    {
+        std::cerr << "Usage: " << argv[0] << " <box_size> <positions_file> <T_min> <T_max> <replicas>"
+                  << " [--segments S] [--interval steps] [--workers W] [--dt dt] [--out prefix]\n";
+        return 1;
+    }
+
+    const double box_size = std::atof(args[0].c_str());
+    const double T_min = std::atof(args[2].c_str()), T_max = std::atof(args[3].c_str());
+    const int n_replicas = std::atoi(args[4].c_str());
+    if (box_size < 5.0 || T_min <= 0.0 || T_max < T_min || n_replicas < 1 || workers < 1)
+    {
+        std::cerr << "Error: need box_size >= 5, 0 < T_min <= T_max, replicas >= 1.\n";
+        return 1;
+    }
+
+    auto positions = readXYZPositions(box_size, args[1]);
+    MolecularSystem start(box_size);
+    start.reserve(positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i)
+        start.add_molecule(Molecule(static_cast<int>(i), positions[i][0], positions[i][1], positions[i][2]));
+
+    // Geometric ladder: equal acceptance for a constant heat capacity
+    std::vector<double> temperatures(n_replicas);
+    for (int r = 0; r < n_replicas; r++)
+        temperatures[r] = n_replicas == 1 ? T_min : T_min * std::pow(T_max / T_min, double(r) / (n_replicas - 1));
+
+    try
+    {
+        ReplicaExchange remd(start, temperatures, options);
+        WorkStealingPool pool(workers);
+        auto t0 = std::chrono::steady_clock::now();
+        remd.run(pool);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - t0;
+
+        const double steps = double(n_replicas) * options.segments * options.exchange_interval;
+        std::cout << n_replicas << " replicas x " << options.segments << " x " << options.exchange_interval
+                  << " steps of " << positions.size() << " atoms on " << workers << " workers: "
+                  << elapsed.count() << " ms, " << steps / (elapsed.count() / 1000.0) << " replica steps/s, "
+                  << pool.steals() << " steals\n";
+        for (std::size_t k = 0; k < remd.attempts().size(); k++)
+        {
+            std::cout << "T " << temperatures[k] << " <-> " << temperatures[k + 1] << ": "
+                      << remd.accepted()[k] << "/" << remd.attempts()[k] << " accepted\n";
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
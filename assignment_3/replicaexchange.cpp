@@ -0,0 +1,144 @@
+#include "replicaexchange.h"
+#include <cmath>
+#include <stdexcept>
+
+ReplicaExchange::ReplicaExchange(const MolecularSystem &start, const std::vector<double> &temperatures,
+                                 const ReplicaOptions &options)
+    : opt(options), temps(temperatures), replicas(temperatures.size()),
+      slot_of(temperatures.size()), at_slot(temperatures.size()),
+      n_attempts(temperatures.size() > 1 ? temperatures.size() - 1 : 0, 0),
+      n_accepted(n_attempts.size(), 0), rng(options.seed)
+{
+    if (temps.empty() || opt.exchange_interval < 1)
+        throw std::invalid_argument("need at least one temperature and a positive exchange interval");
+
+    const int n = num_replicas();
+    for (int r = 0; r < n; r++)
+    {
+        Replica &rep = replicas[r];
+        rep.system = std::make_unique<MolecularSystem>(start);
+        slot_of[r] = at_slot[r] = r;
+
+        // Maxwell-Boltzmann velocities at the replica's temperature, no drift
+        std::mt19937_64 gen(opt.seed + 1000 * (r + 1));
+        std::normal_distribution<double> gauss(0.0, std::sqrt(temps[r]));
+        auto &molecules = rep.system->get_molecules();
+        std::array<double, 3> mean = {0.0, 0.0, 0.0};
+        for (auto &mol : molecules)
+        {
+            auto &v = mol.get_velocities();
+            for (int d = 0; d < 3; d++)
+            {
+                v[d] = gauss(gen);
+                mean[d] += v[d] / molecules.size();
+            }
+        }
+        for (auto &mol : molecules)
+            for (int d = 0; d < 3; d++)
+                mol.get_velocities()[d] -= mean[d];
+
+        MDOptions md = opt.md;
+        md.temperature = temps[r];
+        md.seed = opt.seed + r;
+        rep.md = std::make_unique<MDIntegrator>(*rep.system, md);
+        rep.log.open(opt.output_prefix + "_" + std::to_string(r) + ".dat");
+        if (!rep.log)
+            throw std::runtime_error("could not open log for replica " + std::to_string(r));
+        rep.log << "# segment temperature E_pot E_kin\n";
+    }
+}
+
+int ReplicaExchange::num_replicas() const
+{
+    return static_cast<int>(replicas.size());
+}
+
+const std::vector<long> &ReplicaExchange::attempts() const
+{
+    return n_attempts;
+}
+
+const std::vector<long> &ReplicaExchange::accepted() const
+{
+    return n_accepted;
+}
+
+const std::vector<int> &ReplicaExchange::slot_of_replica() const
+{
+    return slot_of;
+}
+
+void ReplicaExchange::run(WorkStealingPool &pool)
+{
+    for (int r = 0; r < num_replicas(); r++)
+        launch(pool, r);
+    pool.wait_idle();
+}
+
+void ReplicaExchange::launch(WorkStealingPool &pool, int r)
+{
+    pool.submit([this, &pool, r]
+                {
+                    Replica &rep = replicas[r];
+                    rep.md->run(opt.exchange_interval);
+                    // Only this task touches the replica until it reports back
+                    rep.log << rep.segment + 1 << " " << rep.md->temperature() << " "
+                            << rep.md->potential_energy() << " " << rep.system->total_kinetic_energy() << "\n";
+                    finished_segment(pool, r); });
+}
+
+// Called by a replica's task once its interval is done. At boundary k the
+// pairs (s, s + 1) with s % 2 == k % 2 exchange; the second replica of a
+// pair to arrive does the attempt and relaunches both.
+void ReplicaExchange::finished_segment(WorkStealingPool &pool, int r)
+{
+    std::vector<int> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const int k = ++replicas[r].segment;
+        if (k >= opt.segments)
+            return;
+        const int s = slot_of[r];
+        const int partner = s % 2 == k % 2 ? s + 1 : s - 1;
+        if (partner < 0 || partner >= num_replicas())
+        {
+            next.push_back(r);
+        }
+        else
+        {
+            const int q = at_slot[partner];
+            if (replicas[q].segment != k)
+                return; // partner still running; it will finish the pair
+            try_exchange(std::min(s, partner));
+            next = {r, q};
+        }
+    }
+    for (int rr : next)
+        launch(pool, rr);
+}
+
+// Metropolis swap of the temperatures at ladder positions s and s + 1.
+void ReplicaExchange::try_exchange(int s)
+{
+    const int a = at_slot[s], b = at_slot[s + 1];
+    const double beta_a = 1.0 / temps[s], beta_b = 1.0 / temps[s + 1];
+    const double u_a = replicas[a].md->potential_energy(), u_b = replicas[b].md->potential_energy();
+    const double delta = (beta_a - beta_b) * (u_a - u_b);
+    n_attempts[s]++;
+    if (delta < 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) >= std::exp(delta))
+        return;
+
+    n_accepted[s]++;
+    std::swap(at_slot[s], at_slot[s + 1]);
+    slot_of[a] = s + 1;
+    slot_of[b] = s;
+    for (int r : {a, b})
+    {
+        const double T_new = temps[slot_of[r]];
+        const double scale = std::sqrt(T_new / replicas[r].md->temperature());
+        for (auto &mol : replicas[r].system->get_molecules())
+            for (double &v : mol.get_velocities())
+                v *= scale;
+        replicas[r].md->set_temperature(T_new);
+    }
+}
@@ -0,0 +1,68 @@
+// replicaexchange.h
+#ifndef REPLICAEXCHANGE_H
+#define REPLICAEXCHANGE_H
+
+#include "integrator.h"
+#include "molecularsystem.h"
+#include "workpool.h"
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+struct ReplicaOptions
+{
+    int exchange_interval = 100; // MD steps between exchange attempts
+    int segments = 100;          // exchange intervals to run
+    MDOptions md;                // temperature and seed are set per replica
+    std::string output_prefix = "replica";
+    unsigned long seed = 1;
+};
+
+// Parallel tempering: one Langevin MD replica per temperature, all in one
+// process. Each interval of a replica is a task on a shared work-stealing
+// pool. Exchanges alternate between even and odd neighbouring temperature
+// pairs; a pair is tried as soon as both of its replicas have finished the
+// interval, so no replica waits for the whole ladder. Temperatures are
+// swapped, not configurations, with velocities rescaled to the new one.
+// Replica r logs "segment temperature E_pot E_kin" to <prefix>_<r>.dat.
+class ReplicaExchange
+{
+public:
+    ReplicaExchange(const MolecularSystem &start, const std::vector<double> &temperatures,
+                    const ReplicaOptions &options = ReplicaOptions());
+
+    void run(WorkStealingPool &pool);
+
+    int num_replicas() const;
+    // Per neighbouring pair (k, k + 1) of the temperature ladder.
+    const std::vector<long> &attempts() const;
+    const std::vector<long> &accepted() const;
+    // Ladder position of each replica and replica at each position.
+    const std::vector<int> &slot_of_replica() const;
+
+private:
+    struct Replica
+    {
+        std::unique_ptr<MolecularSystem> system;
+        std::unique_ptr<MDIntegrator> md;
+        std::ofstream log;
+        int segment = 0; // intervals finished
+    };
+
+    void launch(WorkStealingPool &pool, int r);
+    void finished_segment(WorkStealingPool &pool, int r);
+    void try_exchange(int slot);
+
+    ReplicaOptions opt;
+    std::vector<double> temps;
+    std::vector<Replica> replicas;
+    std::vector<int> slot_of, at_slot;
+    std::vector<long> n_attempts, n_accepted;
+    std::mutex mutex;
+    std::mt19937_64 rng;
+};
+
+#endif
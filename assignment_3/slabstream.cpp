@@ -0,0 +1,416 @@
+#include "slabstream.h"
+#include "molecule.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace
+{
+const char magic[8] = {'M', 'D', 'S', 'L', 'A', 'B', '0', '1'};
+const double cutoff = 2.5;
+
+struct Header
+{
+    char magic[8];
+    double box;
+    std::uint64_t atoms;
+    std::uint32_t layers, reserved;
+};
+
+// Cells of at least the cutoff; the same count per axis and for the layers
+int cells_per_side(double box_size)
+{
+    const int n = static_cast<int>(box_size / cutoff);
+    if (n < 3)
+        throw std::runtime_error("slab files need a box of at least 3 cutoffs");
+    return n;
+}
+
+double wrap(double x, double box_size)
+{
+    x -= box_size * std::floor(x / box_size);
+    return x < box_size ? x : 0.0;
+}
+
+int cell_of(double x, double inv_cell, int n)
+{
+    const int c = static_cast<int>(x * inv_cell);
+    return c < n ? c : n - 1;
+}
+
+void write_all(int fd, const void *data, std::size_t bytes, std::uint64_t offset)
+{
+    const char *p = static_cast<const char *>(data);
+    while (bytes > 0)
+    {
+        const ssize_t w = pwrite(fd, p, bytes, static_cast<off_t>(offset));
+        if (w <= 0)
+            throw std::runtime_error(std::string("slab write failed: ") + std::strerror(errno));
+        p += w;
+        bytes -= w;
+        offset += w;
+    }
+}
+
+void read_all(int fd, void *data, std::size_t bytes, std::uint64_t offset)
+{
+    char *p = static_cast<char *>(data);
+    while (bytes > 0)
+    {
+        const ssize_t r = pread(fd, p, bytes, static_cast<off_t>(offset));
+        if (r <= 0)
+            throw std::runtime_error(r == 0 ? "slab file is truncated"
+                                            : std::string("slab read failed: ") + std::strerror(errno));
+        p += r;
+        bytes -= r;
+        offset += r;
+    }
+}
+
+std::uint64_t data_offset_for(int layers)
+{
+    return sizeof(Header) + sizeof(std::uint64_t) * (layers + 1);
+}
+
+void write_header(int fd, double box_size, const std::vector<std::uint64_t> &starts)
+{
+    Header h;
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.box = box_size;
+    h.atoms = starts.back();
+    h.layers = static_cast<std::uint32_t>(starts.size() - 1);
+    h.reserved = 0;
+    write_all(fd, &h, sizeof(h), 0);
+    write_all(fd, starts.data(), sizeof(std::uint64_t) * starts.size(), sizeof(h));
+}
+
+// Orders one layer by its x-y cell, so readers find the cells by a scan
+void sort_layer(std::vector<std::array<double, 3>> &atoms, double inv_cell, int n)
+{
+    std::vector<std::size_t> count(static_cast<std::size_t>(n) * n + 1, 0);
+    for (const auto &x : atoms)
+        count[cell_of(x[1], inv_cell, n) * n + cell_of(x[0], inv_cell, n) + 1]++;
+    for (std::size_t c = 1; c < count.size(); c++)
+        count[c] += count[c - 1];
+    std::vector<std::array<double, 3>> sorted(atoms.size());
+    for (const auto &x : atoms)
+        sorted[count[cell_of(x[1], inv_cell, n) * n + cell_of(x[0], inv_cell, n)]++] = x;
+    atoms.swap(sorted);
+}
+
+int open_for_writing(const std::string &filename)
+{
+    const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot create " + filename + ": " + std::strerror(errno));
+    return fd;
+}
+
+// Calls visit(x) for each atom line of an XYZ file, x wrapped into the box
+template <typename Visit>
+std::size_t for_each_xyz_atom(const std::string &filename, double box_size, Visit visit)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("cannot open " + filename);
+    std::size_t num_atoms = 0, seen = 0;
+    std::string line;
+    if (std::getline(file, line))
+        std::istringstream(line) >> num_atoms;
+    std::getline(file, line);
+    std::string atom;
+    std::array<double, 3> x;
+    while (seen < num_atoms && std::getline(file, line))
+    {
+        std::istringstream iss(line);
+        if (iss >> atom >> x[0] >> x[1] >> x[2])
+        {
+            for (int d = 0; d < 3; d++)
+                x[d] = wrap(x[d], box_size);
+            visit(x);
+            seen++;
+        }
+    }
+    return seen;
+}
+} // namespace
+
+SlabFile::SlabFile(const std::string &filename)
+{
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + filename + ": " + std::strerror(errno));
+    try
+    {
+        Header h;
+        read_all(fd, &h, sizeof(h), 0);
+        if (std::memcmp(h.magic, magic, sizeof(magic)) != 0)
+            throw std::runtime_error(filename + " is not a slab file");
+        box = h.box;
+        starts.resize(h.layers + 1);
+        read_all(fd, starts.data(), sizeof(std::uint64_t) * starts.size(), sizeof(h));
+        if (static_cast<int>(h.layers) != cells_per_side(box) || starts.back() != h.atoms)
+            throw std::runtime_error(filename + " has an inconsistent layer index");
+        data_offset = data_offset_for(h.layers);
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+}
+
+SlabFile::~SlabFile()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+double SlabFile::box_size() const
+{
+    return box;
+}
+
+std::size_t SlabFile::num_atoms() const
+{
+    return starts.back();
+}
+
+int SlabFile::num_layers() const
+{
+    return static_cast<int>(starts.size()) - 1;
+}
+
+std::size_t SlabFile::layer_start(int layer) const
+{
+    return starts[layer];
+}
+
+std::size_t SlabFile::largest_layer() const
+{
+    std::size_t largest = 0;
+    for (int l = 0; l < num_layers(); l++)
+        largest = std::max<std::size_t>(largest, starts[l + 1] - starts[l]);
+    return largest;
+}
+
+void SlabFile::read_layers(int first, int last, std::vector<std::array<double, 3>> &out) const
+{
+    const std::size_t before = out.size();
+    out.resize(before + starts[last] - starts[first]);
+    read_all(fd, out.data() + before, sizeof(std::array<double, 3>) * (starts[last] - starts[first]),
+             data_offset + sizeof(std::array<double, 3>) * starts[first]);
+}
+
+void write_slab_file(const std::string &filename, double box_size,
+                     const std::vector<std::array<double, 3>> &positions)
+{
+    const int n = cells_per_side(box_size);
+    const double inv_cell = n / box_size;
+    std::vector<std::vector<std::array<double, 3>>> layers(n);
+    for (auto x : positions)
+    {
+        for (int d = 0; d < 3; d++)
+            x[d] = wrap(x[d], box_size);
+        layers[cell_of(x[2], inv_cell, n)].push_back(x);
+    }
+    std::vector<std::uint64_t> starts(n + 1, 0);
+    for (int l = 0; l < n; l++)
+        starts[l + 1] = starts[l] + layers[l].size();
+
+    const int fd = open_for_writing(filename);
+    try
+    {
+        write_header(fd, box_size, starts);
+        for (int l = 0; l < n; l++)
+        {
+            sort_layer(layers[l], inv_cell, n);
+            write_all(fd, layers[l].data(), sizeof(std::array<double, 3>) * layers[l].size(),
+                      data_offset_for(n) + sizeof(std::array<double, 3>) * starts[l]);
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+void pack_xyz_to_slab(const std::string &xyz_filename, double box_size, const std::string &slab_filename)
+{
+    const int n = cells_per_side(box_size);
+    const double inv_cell = n / box_size;
+    const std::size_t atom_bytes = sizeof(std::array<double, 3>);
+    const std::size_t buffer_atoms = 4096;
+
+    std::vector<std::uint64_t> starts(n + 1, 0);
+    for_each_xyz_atom(xyz_filename, box_size, [&](const std::array<double, 3> &x)
+                      { starts[cell_of(x[2], inv_cell, n) + 1]++; });
+    for (int l = 0; l < n; l++)
+        starts[l + 1] += starts[l];
+
+    const int fd = open_for_writing(slab_filename);
+    try
+    {
+        write_header(fd, box_size, starts);
+        const std::uint64_t base = data_offset_for(n);
+        std::vector<std::uint64_t> cursor(starts.begin(), starts.end() - 1);
+        std::vector<std::vector<std::array<double, 3>>> pending(n);
+        auto flush = [&](int l)
+        {
+            write_all(fd, pending[l].data(), atom_bytes * pending[l].size(), base + atom_bytes * cursor[l]);
+            cursor[l] += pending[l].size();
+            pending[l].clear();
+        };
+        const std::size_t second = for_each_xyz_atom(xyz_filename, box_size, [&](const std::array<double, 3> &x)
+                                                     {
+                                                         const int l = cell_of(x[2], inv_cell, n);
+                                                         pending[l].push_back(x);
+                                                         if (pending[l].size() == buffer_atoms)
+                                                             flush(l); });
+        if (second != starts[n])
+            throw std::runtime_error(xyz_filename + " changed while packing");
+        for (int l = 0; l < n; l++)
+            flush(l);
+        pending.clear();
+
+        // Cell order inside each layer, one layer in memory at a time
+        std::vector<std::array<double, 3>> layer;
+        for (int l = 0; l < n; l++)
+        {
+            layer.resize(starts[l + 1] - starts[l]);
+            read_all(fd, layer.data(), atom_bytes * layer.size(), base + atom_bytes * starts[l]);
+            sort_layer(layer, inv_cell, n);
+            write_all(fd, layer.data(), atom_bytes * layer.size(), base + atom_bytes * starts[l]);
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+// Pairs with at least one atom in the first `layers` layers of x; the layer
+// after them is the halo. cell_start indexes (layer, y, x) cells of x.
+static double slab_energy(const std::vector<std::array<double, 3>> &x, const std::vector<std::size_t> &cell_start,
+                          int layers, int n, double box_size)
+{
+    const double half = 0.5 * box_size;
+    const long cells = static_cast<long>(layers) * n * n;
+    double energy = 0.0;
+#pragma omp parallel for reduction(+ : energy) schedule(dynamic, 64)
+    for (long c = 0; c < cells; c++)
+    {
+        const int cx = static_cast<int>(c % n), cy = static_cast<int>((c / n) % n);
+        const long cz = c / (static_cast<long>(n) * n);
+        const std::size_t begin = cell_start[c], end = cell_start[c + 1];
+        if (begin == end)
+            continue;
+        for (int k = 0; k < 14; k++)
+        {
+            // Own cell, then the 13 cells ahead in (z, y, x) order: nothing
+            // below this layer is needed
+            const int oz = k == 0 ? 0 : (k < 10 ? 1 : 0);
+            const int oy = k == 0 ? 0 : (k < 10 ? (k - 1) / 3 - 1 : (k < 13 ? 1 : 0));
+            const int ox = k == 0 ? 0 : (k < 10 ? (k - 1) % 3 - 1 : (k < 13 ? k - 11 : 1));
+            const long nb = ((cz + oz) * n + (cy + oy + n) % n) * n + (cx + ox + n) % n;
+            for (std::size_t i = begin; i < end; i++)
+            {
+                const std::size_t j0 = k == 0 ? i + 1 : cell_start[nb];
+                const std::size_t j1 = cell_start[nb + 1];
+                for (std::size_t j = j0; j < j1; j++)
+                {
+                    double dx = x[i][0] - x[j][0];
+                    double dy = x[i][1] - x[j][1];
+                    const double dz = x[i][2] - x[j][2];
+                    dx += dx < -half ? box_size : (dx > half ? -box_size : 0.0);
+                    dy += dy < -half ? box_size : (dy > half ? -box_size : 0.0);
+                    energy += lj_energy_r2(dx * dx + dy * dy + dz * dz);
+                }
+            }
+        }
+    }
+    return energy;
+}
+
+double slab_streaming_energy(const SlabFile &file, std::size_t memory_bytes, SlabStats *stats)
+{
+    const int n = file.num_layers();
+    const double box_size = file.box_size();
+    const double inv_cell = n / box_size;
+    const std::size_t layer_bytes = std::max<std::size_t>(1, file.largest_layer()) * sizeof(std::array<double, 3>);
+    // Layer 0 kept as the last halo, then the current and the prefetched
+    // slab, each with its halo layer
+    const long fit = (static_cast<long>(memory_bytes / layer_bytes) - 1) / 2 - 1;
+    const int per_slab = static_cast<int>(std::min<long>(n, std::max(1L, fit)));
+
+    SlabStats local;
+    local.layers_per_slab = per_slab;
+
+    std::vector<std::array<double, 3>> layer0;
+    file.read_layers(0, 1, layer0);
+    for (auto &x : layer0)
+        x[2] += box_size;
+
+    // Slab [first, first + per_slab) followed by its halo layer
+    auto load = [&file, &layer0, n, per_slab](int first)
+    {
+        const int last = std::min(first + per_slab, n);
+        std::vector<std::array<double, 3>> x;
+        x.reserve(file.layer_start(last) - file.layer_start(first) + layer0.size());
+        file.read_layers(first, std::min(last + 1, n), x);
+        if (last == n)
+            x.insert(x.end(), layer0.begin(), layer0.end());
+        return x;
+    };
+
+    double energy = 0.0;
+    std::future<std::vector<std::array<double, 3>>> next =
+        std::async(std::launch::async, load, 0);
+    std::vector<std::size_t> cell_start;
+    for (int first = 0; first < n; first += per_slab)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::array<double, 3>> x = next.get();
+        auto t1 = std::chrono::steady_clock::now();
+        const int last = std::min(first + per_slab, n);
+        if (last < n)
+            next = std::async(std::launch::async, load, last);
+        const std::size_t prefetched =
+            last < n ? file.layer_start(std::min(last + per_slab + 1, n)) - file.layer_start(last) : 0;
+        local.peak_resident_atoms = std::max(local.peak_resident_atoms, x.size() + prefetched + layer0.size());
+
+        // Layers are contiguous in x and each is sorted by x-y cell
+        const int layers = last - first;
+        const std::size_t cells_per_layer = static_cast<std::size_t>(n) * n;
+        cell_start.assign(cells_per_layer * (layers + 1) + 1, 0);
+        for (int l = 0; l <= layers; l++)
+        {
+            const std::size_t begin = file.layer_start(first + l) - file.layer_start(first);
+            const std::size_t end = l < layers ? file.layer_start(first + l + 1) - file.layer_start(first) : x.size();
+            for (std::size_t i = begin; i < end; i++)
+                cell_start[l * cells_per_layer + cell_of(x[i][1], inv_cell, n) * n + cell_of(x[i][0], inv_cell, n) + 1]++;
+        }
+        for (std::size_t c = 1; c < cell_start.size(); c++)
+            cell_start[c] += cell_start[c - 1];
+
+        energy += slab_energy(x, cell_start, layers, n, box_size);
+        auto t2 = std::chrono::steady_clock::now();
+        local.read_wait_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        local.compute_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+        local.slabs++;
+    }
+    if (stats)
+        *stats = local;
+    return energy;
+}
@@ -0,0 +1,73 @@
+// slabstream.h
+#ifndef SLABSTREAM_H
+#define SLABSTREAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Spatially sorted binary snapshot (.slab) for systems that do not fit in
+// memory. Positions are wrapped into the box and grouped by z layer; a layer
+// is one cell thick (at least the 2.5 sigma cutoff), so a layer only
+// interacts with itself and the layers directly above and below it.
+//
+// Layout (little-endian):
+//   header  "MDSLAB01", box (f64), atoms (u64), layers (u32), reserved (u32)
+//   index   layer start (u64 each, layers + 1 entries, in atoms)
+//   atoms   x, y, z (f64 each), layer by layer
+class SlabFile
+{
+public:
+    explicit SlabFile(const std::string &filename);
+    ~SlabFile();
+    SlabFile(const SlabFile &) = delete;
+    SlabFile &operator=(const SlabFile &) = delete;
+
+    double box_size() const;
+    std::size_t num_atoms() const;
+    int num_layers() const;
+    std::size_t layer_start(int layer) const;
+    std::size_t largest_layer() const;
+
+    // Appends layers [first, last) to out; safe to call from several
+    // threads at once.
+    void read_layers(int first, int last, std::vector<std::array<double, 3>> &out) const;
+
+private:
+    int fd = -1;
+    double box;
+    std::vector<std::uint64_t> starts;
+    std::uint64_t data_offset;
+};
+
+// Writes positions (wrapped into the box) as a .slab file.
+void write_slab_file(const std::string &filename, double box_size,
+                     const std::vector<std::array<double, 3>> &positions);
+
+// Converts an XYZ file without loading it: one pass counts the atoms per
+// layer, a second pass streams each atom to its layer through a small
+// per-layer buffer.
+void pack_xyz_to_slab(const std::string &xyz_filename, double box_size, const std::string &slab_filename);
+
+struct SlabStats
+{
+    int slabs = 0;
+    int layers_per_slab = 0;
+    std::size_t peak_resident_atoms = 0;
+    double read_wait_ms = 0.0, compute_ms = 0.0;
+};
+
+// Total Lennard-Jones energy of a .slab file, one slab of consecutive layers
+// at a time. A slab is held together with the first layer of the next slab
+// (the cutoff-thick halo; layer 0 for the last slab, shifted by the box),
+// and its pairs are counted with a forward stencil that only looks up in z,
+// so every pair is visited once without the slab below. The next slab is
+// read on a second thread while the current one is evaluated. Slabs are as
+// thick as memory_bytes allows for the current and the prefetched slab plus
+// a copy of layer 0, but at least one layer.
+double slab_streaming_energy(const SlabFile &file, std::size_t memory_bytes = std::size_t(1) << 30,
+                             SlabStats *stats = nullptr);
+
+#endif
@@ -0,0 +1,103 @@
+#include "smallbox.h"
+#include "reduction.h"
+#include <array>
+#include <cmath>
+#include <vector>
+
+double small_box_energy(const numa_vector<Molecule> &molecules, double box_size, double cutoff,
+                        bool reproducible)
+{
+    const long n = static_cast<long>(molecules.size());
+    const double rc2 = cutoff * cutoff;
+    const double ic6 = 1.0 / (rc2 * rc2 * rc2);
+    const double u_cut = 4.0 * (ic6 * ic6 - ic6);
+
+    // Wrapped SoA copy so that the row loops below vectorise
+    numa_vector<double> xs(n), ys(n), zs(n);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        const auto &x = molecules[i].get_coordinates();
+        xs[i] = x[0] - box_size * std::floor(x[0] / box_size);
+        ys[i] = x[1] - box_size * std::floor(x[1] / box_size);
+        zs[i] = x[2] - box_size * std::floor(x[2] / box_size);
+    }
+
+    // Masked shifted LJ, as in the cluster-pair kernel
+    auto pair = [=](double dx, double dy, double dz)
+    {
+        const double r2 = dx * dx + dy * dy + dz * dz;
+        const bool keep = (r2 < rc2) & (r2 >= 1e-12);
+        const double inv_r2 = 1.0 / (keep ? r2 : 1.0);
+        const double inv_r6 = inv_r2 * inv_r2 * inv_r2;
+        return keep ? 4.0 * (inv_r6 * inv_r6 - inv_r6) - u_cut : 0.0;
+    };
+
+    double potential_energy = 0.0;
+    numa_vector<double> rows(reproducible ? n : 0);
+    if (box_size >= 2.0 * cutoff)
+    {
+        // Only the nearest image can be inside the cutoff. Wrapped
+        // differences lie in (-L, L), so one select per axis replaces the
+        // rounding of lj_pair_energy.
+        const double half = 0.5 * box_size;
+#pragma omp parallel for reduction(+ : potential_energy) schedule(dynamic, 16)
+        for (long i = 0; i < n; i++)
+        {
+            const double xi = xs[i], yi = ys[i], zi = zs[i];
+            double row = 0.0;
+#pragma omp simd reduction(+ : row)
+            for (long j = i + 1; j < n; j++)
+            {
+                double dx = xi - xs[j], dy = yi - ys[j], dz = zi - zs[j];
+                dx += dx < -half ? box_size : (dx > half ? -box_size : 0.0);
+                dy += dy < -half ? box_size : (dy > half ? -box_size : 0.0);
+                dz += dz < -half ? box_size : (dz > half ? -box_size : 0.0);
+                row += pair(dx, dy, dz);
+            }
+            if (reproducible)
+                rows[i] = row;
+            else
+                potential_energy += row;
+        }
+        return reproducible ? reproducible_sum(rows) : potential_energy;
+    }
+
+    // Box below 2 rc: replicate the images explicitly. All shifts up to
+    // ceil(rc / L) boxes per axis can reach the cutoff.
+    const int shells = static_cast<int>(std::ceil(cutoff / box_size));
+    std::vector<std::array<double, 3>> shifts;
+    for (int sz = -shells; sz <= shells; sz++)
+        for (int sy = -shells; sy <= shells; sy++)
+            for (int sx = -shells; sx <= shells; sx++)
+                shifts.push_back({sx * box_size, sy * box_size, sz * box_size});
+
+    // A particle also interacts with its own images; half of each, since
+    // both s and -s appear in the list.
+    double self = 0.0;
+    for (const auto &s : shifts)
+    {
+        self += 0.5 * pair(s[0], s[1], s[2]);
+    }
+    const double self_energy = n * self;
+
+#pragma omp parallel for reduction(+ : potential_energy) schedule(dynamic, 16)
+    for (long i = 0; i < n; i++)
+    {
+        double row = 0.0;
+        for (const auto &s : shifts)
+        {
+            const double xi = xs[i] + s[0], yi = ys[i] + s[1], zi = zs[i] + s[2];
+#pragma omp simd reduction(+ : row)
+            for (long j = i + 1; j < n; j++)
+            {
+                row += pair(xi - xs[j], yi - ys[j], zi - zs[j]);
+            }
+        }
+        if (reproducible)
+            rows[i] = row;
+        else
+            potential_energy += row;
+    }
+    return self_energy + (reproducible ? reproducible_sum(rows) : potential_energy);
+}
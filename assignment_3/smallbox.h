@@ -0,0 +1,16 @@
+// smallbox.h
+#ifndef SMALLBOX_H
+#define SMALLBOX_H
+
+#include "molecule.h"
+#include "numa.h"
+
+// Dense all-pairs LJ energy for boxes too small for a cell grid (fewer than
+// 3 cells per side). Every periodic image within the cutoff is counted, so
+// the result is correct for any box size, including boxes below twice the
+// cutoff where more than one image of a particle interacts. With
+// reproducible the per-molecule rows are combined by reproducible_sum().
+double small_box_energy(const numa_vector<Molecule> &molecules, double box_size, double cutoff = 2.5,
+                        bool reproducible = false);
+
+#endif
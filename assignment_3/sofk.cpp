@@ -0,0 +1,124 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "structurefactor.h"
+#include "trajectory.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+
+// Shell averages the slow way: every vector, scalar sin/cos per particle
+static std::vector<SkShell> direct_shells(const std::vector<std::array<double, 3>> &x, double box_size, double k_max)
+{
+    const double dk = 2.0 * M_PI / box_size;
+    const int n_max = static_cast<int>(k_max / dk);
+    std::vector<SkShell> shells(n_max + 2, SkShell{0.0, 0.0, 0});
+    for (int nx = -n_max; nx <= n_max; nx++)
+        for (int ny = -n_max; ny <= n_max; ny++)
+            for (int nz = -n_max; nz <= n_max; nz++)
+            {
+                const double n = std::sqrt(double(nx * nx + ny * ny + nz * nz));
+                if (n == 0.0 || n > k_max / dk)
+                    continue;
+                // Half space only, as in the engine
+                if (nx < 0 || (nx == 0 && ny < 0) || (nx == 0 && ny == 0 && nz < 0))
+                    continue;
+                double c = 0.0, s = 0.0;
+                for (const auto &p : x)
+                {
+                    const double phase = dk * (nx * p[0] + ny * p[1] + nz * p[2]);
+                    c += std::cos(phase);
+                    s += std::sin(phase);
+                }
+                SkShell &sh = shells[static_cast<int>(n + 0.5)];
+                sh.k += n * dk;
+                sh.s += (c * c + s * s) / x.size();
+                sh.vectors++;
+            }
+    std::vector<SkShell> out;
+    for (auto &sh : shells)
+        if (sh.vectors)
+            out.push_back({sh.k / sh.vectors, sh.s / sh.vectors, sh.vectors});
+    return out;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> files;
+    bool check = false;
+    for (int k = 1; k < argc; k++)
+    {
+        if (std::string(argv[k]) == "--check")
+            check = true;
+        else
+            files.push_back(argv[k]);
+    }
+    if (files.size() < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <box_size> <k_max> <positions_file>... [--check]\n"
+                  << "  .trj files contribute every frame, XYZ files their first frame.\n";
+        return 1;
+    }
+    const double box_size = std::atof(files[0].c_str());
+    const double k_max = std::atof(files[1].c_str());
+
+    pin_threads();
+    try
+    {
+        StructureFactor sk(box_size, k_max);
+        std::vector<std::array<double, 3>> first;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t f = 2; f < files.size(); f++)
+        {
+            if (is_trajectory_file(files[f]))
+            {
+                TrajectoryReader reader(files[f]);
+                for (std::size_t k = 0; k < reader.num_frames(); k++)
+                {
+                    auto x = reader.read_frame(k);
+                    sk.add_frame(x);
+                    if (first.empty())
+                        first = std::move(x);
+                }
+            }
+            else
+            {
+                auto x = readXYZPositions(box_size, files[f]);
+                sk.add_frame(x);
+                if (first.empty())
+                    first = std::move(x);
+            }
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "# " << sk.frames() << " frames, " << sk.num_vectors() << " k-vectors, "
+                  << elapsed.count() << " ms\n# k S(k) vectors\n";
+        for (const auto &sh : sk.shells())
+            std::cout << sh.k << " " << sh.s << " " << sh.vectors << "\n";
+
+        if (check && !first.empty())
+        {
+            StructureFactor one(box_size, k_max);
+            one.add_frame(first);
+            const auto fast = one.shells();
+            const auto slow = direct_shells(first, box_size, k_max);
+            double worst = fast.size() == slow.size() ? 0.0 : 1.0;
+            for (std::size_t s = 0; s < std::min(fast.size(), slow.size()); s++)
+                worst = std::max(worst, std::abs(fast[s].s - slow[s].s) / std::max(1.0, slow[s].s));
+            std::cout << "# First frame against direct sin/cos sums: max relative deviation " << worst << "\n";
+            return worst < 1e-8 ? 0 : 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
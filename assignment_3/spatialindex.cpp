@@ -0,0 +1,248 @@
+#include "spatialindex.h"
+#include "molecularsystem.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+using Hit = std::pair<double, int>; // (distance, molecule index)
+
+// Rows are produced by each thread for its static block of query rows and
+// copied into place once the row offsets are known, like the Verlet list.
+template <typename Row>
+void fill_csr(long n_rows, Row row, SpatialCSR &out)
+{
+    out.start.assign(n_rows + 1, 0);
+#pragma omp parallel
+    {
+        std::vector<Hit> hits, buffer;
+        long first = -1;
+#pragma omp for schedule(static)
+        for (long q = 0; q < n_rows; q++)
+        {
+            if (first < 0)
+                first = q;
+            const std::size_t before = hits.size();
+            buffer.clear();
+            row(q, buffer);
+            hits.insert(hits.end(), buffer.begin(), buffer.end());
+            out.start[q + 1] = hits.size() - before;
+        }
+#pragma omp single
+        {
+            for (long q = 0; q < n_rows; q++)
+            {
+                out.start[q + 1] += out.start[q];
+            }
+            out.index.resize(out.start[n_rows]);
+            out.distance.resize(out.start[n_rows]);
+        }
+        if (first >= 0)
+        {
+            for (std::size_t k = 0; k < hits.size(); k++)
+            {
+                out.distance[out.start[first] + k] = hits[k].first;
+                out.index[out.start[first] + k] = hits[k].second;
+            }
+        }
+    }
+}
+
+bool by_index(const Hit &a, const Hit &b)
+{
+    return a.second < b.second;
+}
+} // namespace
+
+SpatialIndex::SpatialIndex(double box_size, double cell_size)
+    : box_size(box_size), grid(box_size, cell_size)
+{
+}
+
+std::size_t SpatialIndex::size() const
+{
+    return by_molecule.size();
+}
+
+void SpatialIndex::build(const numa_vector<Molecule> &molecules)
+{
+    grid.build(molecules);
+    const auto &pos = grid.positions();
+    const auto &order = grid.order();
+    const long n = static_cast<long>(molecules.size());
+    wrapped.resize(n);
+    by_molecule.resize(n);
+    ids.resize(n);
+#pragma omp parallel for schedule(static)
+    for (long s = 0; s < n; s++)
+    {
+        for (int d = 0; d < 3; d++)
+            wrapped[s][d] = pos[s][d] - box_size * std::floor(pos[s][d] / box_size);
+        ids[s] = static_cast<int>(order[s]);
+    }
+#pragma omp parallel for schedule(static)
+    for (long s = 0; s < n; s++)
+    {
+        by_molecule[ids[s]] = wrapped[s];
+    }
+}
+
+int SpatialIndex::reach_of(double r) const
+{
+    if (r < 0.0 || r > 0.5 * box_size)
+        throw std::invalid_argument("query radius must be between 0 and half the box");
+    return std::max(1, static_cast<int>(std::ceil(r / grid.cell_size())));
+}
+
+template <typename Visit>
+void SpatialIndex::visit_cells(const std::array<double, 3> &q, int reach, Visit visit) const
+{
+    const int n_side = grid.cells_per_side();
+    const int c = grid.cell_of(q);
+    const int home[3] = {c % n_side, (c / n_side) % n_side, c / (n_side * n_side)};
+    // Per axis the window cx - reach .. cx + reach, or every cell once if
+    // the window would wrap onto itself
+    const bool all = 2 * reach + 1 >= n_side;
+    const int lo = all ? 0 : -reach, hi = all ? n_side - 1 : reach;
+    const auto &cell_start = grid.cell_start();
+    for (int oz = lo; oz <= hi; oz++)
+    {
+        const int z = all ? oz : (home[2] + oz + n_side) % n_side;
+        for (int oy = lo; oy <= hi; oy++)
+        {
+            const int y = all ? oy : (home[1] + oy + n_side) % n_side;
+            for (int ox = lo; ox <= hi; ox++)
+            {
+                const int x = all ? ox : (home[0] + ox + n_side) % n_side;
+                const int cell = x + y * n_side + z * n_side * n_side;
+                visit(cell_start[cell], cell_start[cell + 1]);
+            }
+        }
+    }
+}
+
+double SpatialIndex::image_distance2(const std::array<double, 3> &q, std::size_t slot) const
+{
+    // Both wrapped, so one select per axis is the minimum image
+    const double half = 0.5 * box_size;
+    double r2 = 0.0;
+    for (int d = 0; d < 3; d++)
+    {
+        double dx = q[d] - wrapped[slot][d];
+        dx += dx < -half ? box_size : (dx > half ? -box_size : 0.0);
+        r2 += dx * dx;
+    }
+    return r2;
+}
+
+void SpatialIndex::within(const std::vector<std::array<double, 3>> &points, double r, SpatialCSR &out) const
+{
+    const int reach = reach_of(r);
+    const double r2 = r * r;
+    fill_csr(static_cast<long>(points.size()), [&](long p, std::vector<Hit> &row)
+             {
+                 std::array<double, 3> q;
+                 for (int d = 0; d < 3; d++)
+                     q[d] = points[p][d] - box_size * std::floor(points[p][d] / box_size);
+                 visit_cells(q, reach, [&](std::size_t first, std::size_t last)
+                             {
+                                 for (std::size_t s = first; s < last; s++)
+                                 {
+                                     const double d2 = image_distance2(q, s);
+                                     if (d2 <= r2)
+                                         row.emplace_back(std::sqrt(d2), ids[s]);
+                                 } });
+                 std::sort(row.begin(), row.end(), by_index); },
+             out);
+}
+
+void SpatialIndex::pairs(double r, SpatialCSR &out, bool each_pair_once) const
+{
+    const int reach = reach_of(r);
+    const double r2 = r * r;
+    fill_csr(static_cast<long>(size()), [&](long i, std::vector<Hit> &row)
+             {
+                 const auto &q = by_molecule[i];
+                 const int min_j = each_pair_once ? static_cast<int>(i) : -1;
+                 visit_cells(q, reach, [&](std::size_t first, std::size_t last)
+                             {
+                                 for (std::size_t s = first; s < last; s++)
+                                 {
+                                     const int j = ids[s];
+                                     if (j == i || j < min_j)
+                                         continue;
+                                     const double d2 = image_distance2(q, s);
+                                     if (d2 <= r2)
+                                         row.emplace_back(std::sqrt(d2), j);
+                                 } });
+                 std::sort(row.begin(), row.end(), by_index); },
+             out);
+}
+
+void SpatialIndex::knn(int k, SpatialCSR &out) const
+{
+    if (k < 0 || static_cast<std::size_t>(k) >= size())
+        throw std::invalid_argument("k must be below the number of molecules");
+    const int n_side = grid.cells_per_side();
+    fill_csr(static_cast<long>(size()), [&](long i, std::vector<Hit> &row)
+             {
+                 if (k == 0)
+                     return;
+                 const auto &q = by_molecule[i];
+                 // Grow the window until the k-th candidate is closer than
+                 // anything outside it can be
+                 for (int reach = 1;; reach++)
+                 {
+                     row.clear();
+                     visit_cells(q, reach, [&](std::size_t first, std::size_t last)
+                                 {
+                                     for (std::size_t s = first; s < last; s++)
+                                     {
+                                         if (ids[s] != i)
+                                             row.emplace_back(image_distance2(q, s), ids[s]);
+                                     } });
+                     const bool everything = 2 * reach + 1 >= n_side;
+                     if (row.size() < static_cast<std::size_t>(k) && !everything)
+                         continue;
+                     std::partial_sort(row.begin(), row.begin() + k, row.end());
+                     const double safe = reach * grid.cell_size();
+                     if (everything || row[k - 1].first <= safe * safe)
+                         break;
+                 }
+                 row.resize(k);
+                 for (Hit &h : row)
+                     h.first = std::sqrt(h.first); },
+             out);
+}
+
+// Defined here so that only binaries with spatial queries link the index.
+struct MolecularSystem::BuiltIndex
+{
+    explicit BuiltIndex(double box_size) : index(box_size) {}
+    SpatialIndex index;
+    std::uint64_t generation = 0;
+};
+
+std::shared_ptr<const SpatialIndex> MolecularSystem::spatial_index() const
+{
+    const std::shared_ptr<const BuiltIndex> built = std::atomic_load(&index);
+    if (!built)
+        throw std::runtime_error("no spatial index: call update_spatial_index() first");
+    if (built->generation != generation)
+        throw std::runtime_error("spatial index is out of date: call update_spatial_index()");
+    // Aliasing: keeps the snapshot alive as long as the caller holds it
+    return std::shared_ptr<const SpatialIndex>(built, &built->index);
+}
+
+void MolecularSystem::update_spatial_index()
+{
+    // Always a fresh snapshot: readers may still hold the old one
+    auto built = std::make_shared<BuiltIndex>(box_size);
+    built->index.build(molecules);
+    built->generation = generation;
+    std::atomic_store(&index, std::shared_ptr<const BuiltIndex>(std::move(built)));
+}
@@ -0,0 +1,60 @@
+// spatialindex.h
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include "cellgrid.h"
+#include "molecule.h"
+#include "numa.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Flat result of a batched query: the hits of query row q are
+// index[start[q] .. start[q + 1]) with their minimum-image distances.
+struct SpatialCSR
+{
+    numa_vector<std::size_t> start;
+    numa_vector<int> index;
+    numa_vector<double> distance;
+
+    std::size_t rows() const { return start.empty() ? 0 : start.size() - 1; }
+};
+
+// Periodic spatial index over a snapshot of the molecules: a cell grid with
+// wrapped positions in cell order. Queries of any radius up to half the box
+// scan only the cells that can hold hits (all of them once the radius
+// reaches across the grid) and run in parallel over the query rows.
+class SpatialIndex
+{
+public:
+    SpatialIndex(double box_size, double cell_size = 2.5);
+
+    // Snapshot of the current positions; queries see them until the next build.
+    void build(const numa_vector<Molecule> &molecules);
+    std::size_t size() const;
+
+    // Molecules within r of each point, by increasing molecule index.
+    void within(const std::vector<std::array<double, 3>> &points, double r, SpatialCSR &out) const;
+    // Row i: molecules j != i within r of molecule i, by increasing index;
+    // with each_pair_once only j > i, so every pair appears once.
+    void pairs(double r, SpatialCSR &out, bool each_pair_once = true) const;
+    // Row i: the k nearest other molecules of molecule i, nearest first
+    // (ties by index). Needs k < size().
+    void knn(int k, SpatialCSR &out) const;
+
+private:
+    // Calls visit(first_slot, last_slot) for every cell within reach cells
+    // of the cell of q, each cell once.
+    template <typename Visit>
+    void visit_cells(const std::array<double, 3> &q, int reach, Visit visit) const;
+    double image_distance2(const std::array<double, 3> &q, std::size_t slot) const;
+    int reach_of(double r) const;
+
+    double box_size;
+    CellGrid grid;
+    numa_vector<std::array<double, 3>> wrapped;      // by cell-ordered slot
+    numa_vector<std::array<double, 3>> by_molecule;  // wrapped, by molecule index
+    numa_vector<int> ids;                            // molecule index of each slot
+};
+
+#endif
@@ -0,0 +1,426 @@
+#include "spme.h"
+#include "molecularsystem.h"
+#include "cellgrid.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+// Cardinal B-spline values M_p(w + t) and derivatives for t = 0 .. p - 1,
+// w in [0, 1); grid point floor(u) - t gets weight M_p(w + t).
+void bspline(double w, int p, double *value, double *derivative)
+{
+    value[0] = w;
+    value[1] = 1.0 - w;
+    for (int t = 2; t < p; t++)
+        value[t] = 0.0;
+    for (int n = 3; n <= p; n++)
+    {
+        if (n == p)
+        {
+            derivative[0] = value[0];
+            for (int t = 1; t < p; t++)
+                derivative[t] = value[t] - value[t - 1];
+        }
+        for (int t = n - 1; t >= 0; t--)
+        {
+            const double below = t > 0 ? value[t - 1] : 0.0;
+            value[t] = ((w + t) * value[t] + (n - w - t) * below) / (n - 1);
+        }
+    }
+    if (p == 2)
+    {
+        derivative[0] = 1.0;
+        derivative[1] = -1.0;
+    }
+}
+
+int next_power_of_two(int n)
+{
+    int p = 1;
+    while (p < n)
+        p *= 2;
+    return p;
+}
+} // namespace
+
+double ewald_alpha(double real_cutoff, double tolerance)
+{
+    double lo = 0.0, hi = 10.0 / real_cutoff;
+    for (int k = 0; k < 100; k++)
+    {
+        const double mid = 0.5 * (lo + hi);
+        (std::erfc(mid * real_cutoff) > tolerance ? lo : hi) = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+SPME::SPME(double box_size, const EwaldOptions &options)
+    : box_size(box_size), beta(ewald_alpha(options.real_cutoff, options.tolerance)), n_order(options.order),
+      // Auto mesh: the reciprocal Gaussian has decayed to the tolerance at
+      // 2/3 of the Nyquist frequency, leaving headroom for the B-spline
+      // interpolation error
+      fft(options.grid > 0 ? options.grid
+                           : std::max(next_power_of_two(static_cast<int>(std::ceil(
+                                          3.0 * box_size * beta * std::sqrt(-std::log(options.tolerance)) / M_PI))),
+                                      next_power_of_two(2 * options.order)))
+{
+    n_mesh = fft.size();
+    if (n_order < 2 || n_order > 12 || n_mesh < n_order)
+        throw std::invalid_argument("B-spline order must be 2..12 and at most the mesh size");
+
+    // |b(m)|^2 of the B-spline interpolation, per axis
+    std::vector<double> value(n_order), derivative(n_order), modulus(n_mesh);
+    bspline(0.0, n_order, value.data(), derivative.data());
+    for (int m = 0; m < n_mesh; m++)
+    {
+        std::complex<double> s = 0.0;
+        for (int k = 0; k < n_order - 1; k++)
+            s += value[k + 1] * std::polar(1.0, 2.0 * M_PI * m * k / n_mesh);
+        modulus[m] = std::norm(s);
+    }
+    for (int m = 0; m < n_mesh; m++)
+    {
+        // Zeros (odd orders at m = n/2) are replaced by their neighbours
+        if (modulus[m] < 1e-7)
+            modulus[m] = 0.5 * (modulus[(m + n_mesh - 1) % n_mesh] + modulus[(m + 1) % n_mesh]);
+    }
+
+    // C(m) B(m) = exp(-pi^2 m^2 / alpha^2) / (pi V m^2) / prod |b|^2
+    const double volume = box_size * box_size * box_size;
+    const long points = static_cast<long>(n_mesh) * n_mesh * n_mesh;
+    influence.assign(points, 0.0);
+#pragma omp parallel for schedule(static)
+    for (long idx = 1; idx < points; idx++)
+    {
+        const int mx = idx % n_mesh, my = (idx / n_mesh) % n_mesh, mz = idx / (n_mesh * n_mesh);
+        auto freq = [&](int m)
+        { return (m <= n_mesh / 2 ? m : m - n_mesh) / box_size; };
+        const double m2 = freq(mx) * freq(mx) + freq(my) * freq(my) + freq(mz) * freq(mz);
+        influence[idx] = std::exp(-M_PI * M_PI * m2 / (beta * beta)) / (M_PI * volume * m2) /
+                         (modulus[mx] * modulus[my] * modulus[mz]);
+    }
+    mesh.resize(points);
+}
+
+double SPME::alpha() const
+{
+    return beta;
+}
+
+int SPME::grid_size() const
+{
+    return n_mesh;
+}
+
+int SPME::order() const
+{
+    return n_order;
+}
+
+double SPME::reciprocal(const numa_vector<Molecule> &molecules, numa_vector<std::array<double, 3>> *forces)
+{
+    const long n = static_cast<long>(molecules.size());
+    const int K = n_mesh, p = n_order;
+    const double scale = K / box_size;
+
+    // Spline weights and first mesh point of every particle
+    std::vector<double> theta(3 * p * n), dtheta(3 * p * n);
+    std::vector<int> first(3 * n);
+#pragma omp parallel for schedule(static)
+    for (long j = 0; j < n; j++)
+    {
+        const auto &x = molecules[j].get_coordinates();
+        for (int d = 0; d < 3; d++)
+        {
+            const double u = scale * (x[d] - box_size * std::floor(x[d] / box_size));
+            const int k0 = std::min(K - 1, static_cast<int>(u));
+            first[3 * j + d] = k0;
+            bspline(u - k0, p, &theta[(3 * j + d) * p], &dtheta[(3 * j + d) * p]);
+        }
+    }
+
+    // Bucket by first z plane, then spread slab block by slab block
+    std::vector<long> plane_start(K + 1, 0), order(n);
+    for (long j = 0; j < n; j++)
+        plane_start[first[3 * j + 2] + 1]++;
+    for (int k = 0; k < K; k++)
+        plane_start[k + 1] += plane_start[k];
+    {
+        std::vector<long> fill(plane_start.begin(), plane_start.end() - 1);
+        for (long j = 0; j < n; j++)
+            order[fill[first[3 * j + 2]]++] = j;
+    }
+
+    std::fill(mesh.begin(), mesh.end(), std::complex<double>(0.0, 0.0));
+    const int n_blocks = K >= 2 * p ? 2 * (K / (2 * p)) : 1;
+    auto spread_block = [&](int b)
+    {
+        const int plane_lo = static_cast<int>(static_cast<long>(b) * K / n_blocks);
+        const int plane_hi = static_cast<int>(static_cast<long>(b + 1) * K / n_blocks);
+        for (long s = plane_start[plane_lo]; s < plane_start[plane_hi]; s++)
+        {
+            const long j = order[s];
+            const double q = molecules[j].get_charge();
+            const double *tx = &theta[(3 * j) * p], *ty = &theta[(3 * j + 1) * p], *tz = &theta[(3 * j + 2) * p];
+            for (int c = 0; c < p; c++)
+            {
+                const long z = (first[3 * j + 2] - c + K) % K;
+                for (int b2 = 0; b2 < p; b2++)
+                {
+                    const long y = (first[3 * j + 1] - b2 + K) % K;
+                    const double qyz = q * tz[c] * ty[b2];
+                    for (int a = 0; a < p; a++)
+                    {
+                        const long x = (first[3 * j] - a + K) % K;
+                        mesh[(z * K + y) * K + x] += qyz * tx[a];
+                    }
+                }
+            }
+        }
+    };
+    for (int parity = 0; parity < 2; parity++)
+    {
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int b = parity; b < n_blocks; b += 2)
+            spread_block(b);
+    }
+
+    // E = 1/2 sum_m B C |F(Q)|^2; the convolution B C * Q drives the forces
+    fft.transform(mesh, -1);
+    // Per-plane sums added in plane order: the same bits on any thread count
+    const long plane = static_cast<long>(K) * K;
+    std::vector<double> plane_energy(K, 0.0);
+#pragma omp parallel for schedule(static)
+    for (int z = 0; z < K; z++)
+    {
+        double e = 0.0;
+        for (long idx = z * plane; idx < (z + 1) * plane; idx++)
+        {
+            e += 0.5 * influence[idx] * std::norm(mesh[idx]);
+            mesh[idx] *= influence[idx];
+        }
+        plane_energy[z] = e;
+    }
+    double energy = 0.0;
+    for (int z = 0; z < K; z++)
+        energy += plane_energy[z];
+    if (!forces)
+        return energy;
+
+    fft.transform(mesh, +1);
+    forces->resize(n);
+#pragma omp parallel for schedule(static)
+    for (long j = 0; j < n; j++)
+    {
+        const double q = molecules[j].get_charge();
+        const double *tx = &theta[(3 * j) * p], *ty = &theta[(3 * j + 1) * p], *tz = &theta[(3 * j + 2) * p];
+        const double *dx = &dtheta[(3 * j) * p], *dy = &dtheta[(3 * j + 1) * p], *dz = &dtheta[(3 * j + 2) * p];
+        double fx = 0.0, fy = 0.0, fz = 0.0;
+        for (int c = 0; c < p; c++)
+        {
+            const long z = (first[3 * j + 2] - c + K) % K;
+            for (int b2 = 0; b2 < p; b2++)
+            {
+                const long y = (first[3 * j + 1] - b2 + K) % K;
+                for (int a = 0; a < p; a++)
+                {
+                    const long x = (first[3 * j] - a + K) % K;
+                    const double conv = mesh[(z * K + y) * K + x].real();
+                    fx += dx[a] * ty[b2] * tz[c] * conv;
+                    fy += tx[a] * dy[b2] * tz[c] * conv;
+                    fz += tx[a] * ty[b2] * dz[c] * conv;
+                }
+            }
+        }
+        (*forces)[j] = {-q * scale * fx, -q * scale * fy, -q * scale * fz};
+    }
+    return energy;
+}
+
+double SPME::self_energy(const numa_vector<Molecule> &molecules) const
+{
+    double q2 = 0.0, total = 0.0;
+    for (const auto &mol : molecules)
+    {
+        q2 += mol.get_charge() * mol.get_charge();
+        total += mol.get_charge();
+    }
+    const double volume = box_size * box_size * box_size;
+    return -beta / std::sqrt(M_PI) * q2 - M_PI * total * total / (2.0 * volume * beta * beta);
+}
+
+double ewald_real_direct(const numa_vector<Molecule> &molecules, double box_size, double alpha,
+                         double real_cutoff, numa_vector<std::array<double, 3>> *forces)
+{
+    const long n = static_cast<long>(molecules.size());
+    const double rc2 = real_cutoff * real_cutoff;
+    // Beyond half the box the minimum image is not enough: every image
+    // within the cutoff counts, including those of the molecule itself.
+    const int images = real_cutoff > 0.5 * box_size ? static_cast<int>(std::ceil(real_cutoff / box_size)) : 0;
+    if (forces)
+        forces->assign(n, {0.0, 0.0, 0.0});
+    double energy = 0.0;
+#pragma omp parallel for reduction(+ : energy) schedule(dynamic, 16)
+    for (long i = 0; i < n; i++)
+    {
+        const auto &xi = molecules[i].get_coordinates();
+        std::array<double, 3> f{0.0, 0.0, 0.0};
+        for (long j = 0; j < n; j++)
+        {
+            const auto &xj = molecules[j].get_coordinates();
+            double base[3];
+            for (int k = 0; k < 3; k++)
+            {
+                base[k] = xi[k] - xj[k];
+                base[k] -= box_size * std::round(base[k] / box_size);
+            }
+            const double qq = molecules[i].get_charge() * molecules[j].get_charge();
+            for (int ix = -images; ix <= images; ix++)
+                for (int iy = -images; iy <= images; iy++)
+                    for (int iz = -images; iz <= images; iz++)
+                    {
+                        const double d[3] = {base[0] + ix * box_size, base[1] + iy * box_size,
+                                             base[2] + iz * box_size};
+                        const double r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+                        if (r2 >= rc2 || (j == i && ix == 0 && iy == 0 && iz == 0))
+                            continue;
+                        const double r = std::sqrt(r2);
+                        const double e = qq * std::erfc(alpha * r) / r;
+                        // Minimum images: each pair once. All images: every
+                        // ordered pair, so half each.
+                        if (images > 0)
+                            energy += 0.5 * e;
+                        else if (j > i)
+                            energy += e;
+                        const double g = (e + qq * 2.0 * alpha / std::sqrt(M_PI) * std::exp(-alpha * alpha * r2)) / r2;
+                        for (int k = 0; k < 3; k++)
+                            f[k] += g * d[k];
+                    }
+        }
+        if (forces)
+            (*forces)[i] = f;
+    }
+    return energy;
+}
+
+double ewald_reciprocal_direct(const numa_vector<Molecule> &molecules, double box_size, double alpha,
+                               int n_max, numa_vector<std::array<double, 3>> *forces)
+{
+    const long n = static_cast<long>(molecules.size());
+    const double volume = box_size * box_size * box_size;
+    const double dk = 2.0 * M_PI / box_size;
+    if (forces)
+        forces->assign(n, {0.0, 0.0, 0.0});
+
+    // Half space, each vector standing for k and -k
+    std::vector<std::array<int, 3>> vectors;
+    for (int nx = 0; nx <= n_max; nx++)
+        for (int ny = nx == 0 ? 0 : -n_max; ny <= n_max; ny++)
+            for (int nz = (nx == 0 && ny == 0) ? 1 : -n_max; nz <= n_max; nz++)
+                if (nx * nx + ny * ny + nz * nz <= n_max * n_max)
+                    vectors.push_back({nx, ny, nz});
+
+    double energy = 0.0;
+    for (const auto &v : vectors)
+    {
+        const double kx = dk * v[0], ky = dk * v[1], kz = dk * v[2];
+        const double k2 = kx * kx + ky * ky + kz * kz;
+        const double a = 2.0 * (2.0 * M_PI / volume) * std::exp(-k2 / (4.0 * alpha * alpha)) / k2;
+        double sr = 0.0, si = 0.0;
+#pragma omp parallel for reduction(+ : sr, si) schedule(static)
+        for (long j = 0; j < n; j++)
+        {
+            const auto &x = molecules[j].get_coordinates();
+            const double phase = kx * x[0] + ky * x[1] + kz * x[2];
+            sr += molecules[j].get_charge() * std::cos(phase);
+            si += molecules[j].get_charge() * std::sin(phase);
+        }
+        energy += a * (sr * sr + si * si);
+        if (!forces)
+            continue;
+#pragma omp parallel for schedule(static)
+        for (long j = 0; j < n; j++)
+        {
+            const auto &x = molecules[j].get_coordinates();
+            const double phase = kx * x[0] + ky * x[1] + kz * x[2];
+            // Im(conj(S) exp(i k.r_j))
+            const double im = sr * std::sin(phase) - si * std::cos(phase);
+            const double g = 2.0 * a * molecules[j].get_charge() * im;
+            (*forces)[j][0] += g * kx;
+            (*forces)[j][1] += g * ky;
+            (*forces)[j][2] += g * kz;
+        }
+    }
+    return energy;
+}
+
+// MolecularSystem backend; defined here so that only binaries using it link
+// the mesh and the FFT.
+double MolecularSystem::total_potential_energy_SPME() const
+{
+    return total_potential_energy_SPME(EwaldOptions{});
+}
+
+double MolecularSystem::total_potential_energy_SPME(const EwaldOptions &options, EwaldEnergy *parts) const
+{
+    auto t0 = std::chrono::steady_clock::now();
+    const double alpha = ewald_alpha(options.real_cutoff, options.tolerance);
+    const double cell_size = std::max(2.5, options.real_cutoff);
+    double lj = 0.0, real = 0.0;
+    if (CellGrid(box_size, cell_size).cells_per_side() < 3)
+    {
+        lj = total_potential_energy_SmallBox();
+        real = ewald_real_direct(molecules, box_size, alpha, options.real_cutoff);
+    }
+    else
+    {
+        // The real-space term rides along the LJ linked-cell pass; charges
+        // are gathered into slot order once the grid is binned
+        numa_vector<double> charge;
+        Phases phases;
+        phases.cell_size = cell_size;
+        phases.binned = [&](const CellGrid &binned)
+        {
+            const auto &order = binned.order();
+            const long n = static_cast<long>(order.size());
+            charge.resize(n);
+#pragma omp parallel for schedule(static)
+            for (long s = 0; s < n; s++)
+            {
+                charge[s] = molecules[order[s]].get_charge();
+            }
+        };
+        phases.pair_term = [&](std::size_t i, std::size_t j, double r2)
+        {
+            const double qq = charge[i] * charge[j];
+            if (qq == 0.0 || r2 < 1e-12)
+                return 0.0;
+            const double r = std::sqrt(r2);
+            return qq * std::erfc(alpha * r) / r;
+        };
+        phases.pair_cutoff = options.real_cutoff;
+        lj = linked_cells_energy(phases, &real);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    SPME spme(box_size, options);
+    const double reciprocal = spme.reciprocal(molecules);
+    const double self = spme.self_energy(molecules);
+    auto t2 = std::chrono::steady_clock::now();
+
+    if (parts)
+    {
+        parts->lj = lj;
+        parts->real = real;
+        parts->reciprocal = reciprocal;
+        parts->self = self;
+        parts->pair_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        parts->mesh_ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        parts->grid = spme.grid_size();
+        parts->alpha = spme.alpha();
+    }
+    return lj + real + reciprocal + self;
+}
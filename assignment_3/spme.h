@@ -0,0 +1,73 @@
+// spme.h
+#ifndef SPME_H
+#define SPME_H
+
+#include "fft.h"
+#include "molecule.h"
+#include "numa.h"
+#include <array>
+#include <complex>
+#include <vector>
+
+// Ewald splitting of the Coulomb energy sum_{i<j} q_i q_j / r_ij:
+//   real space   q_i q_j erfc(alpha r) / r       up to real_cutoff
+//   reciprocal   smooth particle-mesh Ewald (B-splines + FFT)
+//   self         -alpha / sqrt(pi) sum q_i^2, and a uniform background
+//                term when the net charge is not zero.
+struct EwaldOptions
+{
+    double tolerance = 1e-5;   // erfc(alpha real_cutoff); sets alpha
+    double real_cutoff = 2.5;  // the LJ cutoff, so real space shares its cells
+    int order = 6;             // B-spline order (interpolation points per axis)
+    int grid = 0;              // mesh points per side, a power of two; 0 = from tolerance
+};
+
+struct EwaldEnergy
+{
+    double lj = 0.0, real = 0.0, reciprocal = 0.0, self = 0.0;
+    double pair_ms = 0.0, mesh_ms = 0.0;
+    int grid = 0;
+    double alpha = 0.0;
+};
+
+// alpha with erfc(alpha * real_cutoff) = tolerance.
+double ewald_alpha(double real_cutoff, double tolerance);
+
+// Reciprocal part by SPME (Essmann et al. 1995). Charges are spread onto
+// the mesh by slabs of z planes: particles are bucketed by their first
+// plane, and slab blocks at least `order` planes wide are filled even
+// blocks first, then odd, so threads never write the same plane and the
+// result does not depend on the thread count.
+class SPME
+{
+public:
+    SPME(double box_size, const EwaldOptions &options = {});
+
+    double alpha() const;
+    int grid_size() const;
+    int order() const;
+
+    // Reciprocal energy; forces (if given) are resized and overwritten.
+    double reciprocal(const numa_vector<Molecule> &molecules,
+                      numa_vector<std::array<double, 3>> *forces = nullptr);
+    // Self energy plus the neutralising background for a net charge.
+    double self_energy(const numa_vector<Molecule> &molecules) const;
+
+private:
+    double box_size, beta;
+    int n_mesh, n_order;
+    FFT3D fft;
+    std::vector<double> influence; // B(m) C(m) per mesh point, 0 at m = 0
+    std::vector<std::complex<double>> mesh;
+};
+
+// Reference terms for checks on small systems.
+// Real space over minimum images, or over all images within real_cutoff
+// if that is more than half the box.
+double ewald_real_direct(const numa_vector<Molecule> &molecules, double box_size, double alpha,
+                         double real_cutoff, numa_vector<std::array<double, 3>> *forces = nullptr);
+// Reciprocal space as a direct sum over k = 2 pi n / L, |n| <= n_max.
+double ewald_reciprocal_direct(const numa_vector<Molecule> &molecules, double box_size, double alpha,
+                               int n_max, numa_vector<std::array<double, 3>> *forces = nullptr);
+
+#endif
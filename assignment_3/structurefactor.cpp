@@ -0,0 +1,160 @@
+#include "structurefactor.h"
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+StructureFactor::StructureFactor(double box_size, double k_max, double shell_width)
+    : box_size(box_size)
+{
+    const double dk = 2.0 * M_PI / box_size;
+    const double width = shell_width > 0.0 ? shell_width : dk;
+    const double n_cut = k_max / dk;
+    n_max = static_cast<int>(std::floor(n_cut));
+    if (n_max < 1)
+        throw std::invalid_argument("k_max is below the smallest k-vector 2 pi / L");
+
+    // Half space: nx > 0, or nx = 0 and ny > 0, or nx = ny = 0 and nz > 0
+    for (int nx = 0; nx <= n_max; nx++)
+    {
+        for (int ny = nx == 0 ? 0 : -n_max; ny <= n_max; ny++)
+        {
+            Column col{nx, ny, {}, {}};
+            for (int nz = (nx == 0 && ny == 0) ? 1 : -n_max; nz <= n_max; nz++)
+            {
+                const double n = std::sqrt(double(nx * nx + ny * ny + nz * nz));
+                if (n > n_cut)
+                    continue;
+                const int shell = static_cast<int>(n * dk / width + 0.5);
+                if (shell >= static_cast<int>(shell_k.size()))
+                {
+                    shell_k.resize(shell + 1, 0.0);
+                    shell_count.resize(shell + 1, 0);
+                }
+                shell_k[shell] += n * dk;
+                shell_count[shell]++;
+                col.nz.push_back(nz);
+                col.shell.push_back(shell);
+                n_vectors++;
+            }
+            if (!col.nz.empty())
+                columns.push_back(std::move(col));
+        }
+    }
+    shell_sum.assign(shell_k.size(), 0.0);
+}
+
+std::size_t StructureFactor::frames() const
+{
+    return n_frames;
+}
+
+std::size_t StructureFactor::num_vectors() const
+{
+    return n_vectors;
+}
+
+void StructureFactor::add_frame(const std::vector<std::array<double, 3>> &positions)
+{
+    accumulate(positions.size(), [&](std::size_t j)
+               { return positions[j]; });
+}
+
+void StructureFactor::add_frame(const MolecularSystem &system)
+{
+    if (system.get_box_size() != box_size)
+        throw std::invalid_argument("system box differs from the S(k) box");
+    const auto &molecules = system.get_molecules();
+    accumulate(molecules.size(), [&](std::size_t j)
+               { return molecules[j].get_coordinates(); });
+}
+
+template <typename Position>
+void StructureFactor::accumulate(std::size_t n, Position position)
+{
+    const long count = static_cast<long>(n);
+    const int width = n_max + 1;
+    // exp(i 2 pi m x / L) for m = 0 .. n_max, as [axis][m][j] so that the
+    // particle loop runs over contiguous memory; negative m is the conjugate
+    std::vector<double> re(3 * width * n), im(3 * width * n);
+    auto at = [&](int axis, int m)
+    { return (static_cast<std::size_t>(axis) * width + std::abs(m)) * n; };
+    auto sign = [](int m)
+    { return m < 0 ? -1.0 : 1.0; };
+
+    const double dk = 2.0 * M_PI / box_size;
+#pragma omp parallel for schedule(static)
+    for (long j = 0; j < count; j++)
+    {
+        const auto x = position(j);
+        for (int d = 0; d < 3; d++)
+        {
+            const double c = std::cos(dk * x[d]), s = std::sin(dk * x[d]);
+            double cr = 1.0, ci = 0.0;
+            re[at(d, 0) + j] = 1.0;
+            im[at(d, 0) + j] = 0.0;
+            for (int m = 1; m <= n_max; m++)
+            {
+                const double nr = cr * c - ci * s;
+                ci = cr * s + ci * c;
+                cr = nr;
+                re[at(d, m) + j] = cr;
+                im[at(d, m) + j] = ci;
+            }
+        }
+    }
+
+    std::vector<double> sums(shell_sum.size(), 0.0);
+    const long n_columns = static_cast<long>(columns.size());
+#pragma omp parallel
+    {
+        std::vector<double> local(sums.size(), 0.0);
+        std::vector<double> pr(n), pi(n);
+#pragma omp for schedule(dynamic, 4)
+        for (long c = 0; c < n_columns; c++)
+        {
+            const Column &col = columns[c];
+            const double *xr = &re[at(0, col.nx)], *xi = &im[at(0, col.nx)];
+            const double *yr = &re[at(1, col.ny)], *yi = &im[at(1, col.ny)];
+            const double sy = sign(col.ny);
+#pragma omp simd
+            for (long j = 0; j < count; j++)
+            {
+                pr[j] = xr[j] * yr[j] - xi[j] * (sy * yi[j]);
+                pi[j] = xr[j] * (sy * yi[j]) + xi[j] * yr[j];
+            }
+            for (std::size_t v = 0; v < col.nz.size(); v++)
+            {
+                const double *zr = &re[at(2, col.nz[v])], *zi = &im[at(2, col.nz[v])];
+                const double sz = sign(col.nz[v]);
+                double rho_r = 0.0, rho_i = 0.0;
+#pragma omp simd reduction(+ : rho_r, rho_i)
+                for (long j = 0; j < count; j++)
+                {
+                    rho_r += pr[j] * zr[j] - pi[j] * (sz * zi[j]);
+                    rho_i += pr[j] * (sz * zi[j]) + pi[j] * zr[j];
+                }
+                local[col.shell[v]] += (rho_r * rho_r + rho_i * rho_i) / count;
+            }
+        }
+#pragma omp critical
+        for (std::size_t s = 0; s < sums.size(); s++)
+            sums[s] += local[s];
+    }
+
+    for (std::size_t s = 0; s < sums.size(); s++)
+        shell_sum[s] += sums[s];
+    n_frames++;
+}
+
+std::vector<SkShell> StructureFactor::shells() const
+{
+    std::vector<SkShell> out;
+    for (std::size_t s = 0; s < shell_k.size(); s++)
+    {
+        if (shell_count[s] == 0)
+            continue;
+        const double frames = n_frames ? static_cast<double>(n_frames) : 1.0;
+        out.push_back({shell_k[s] / shell_count[s], shell_sum[s] / (shell_count[s] * frames), shell_count[s]});
+    }
+    return out;
+}
@@ -0,0 +1,60 @@
+// structurefactor.h
+#ifndef STRUCTUREFACTOR_H
+#define STRUCTUREFACTOR_H
+
+#include "molecularsystem.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+struct SkShell
+{
+    double k;     // mean |k| of the vectors in the shell
+    double s;     // S(k) averaged over the vectors and frames
+    long vectors; // k-vectors per frame in the shell
+};
+
+// Static structure factor S(k) = |rho(k)|^2 / N, rho(k) = sum_j exp(i k.r_j),
+// over the k-vectors of the periodic box, k = 2 pi / L (nx, ny, nz), up to
+// k_max. Only one of k and -k is evaluated (S is even). Per frame every
+// particle gets exp(i 2 pi m x / L) for m >= 0 by recurrence along each axis
+// (negative m is the conjugate), one sin/cos pair per particle and axis; rho(k)
+// is then a product of table entries summed over particles with SIMD. k-vectors
+// sharing (nx, ny) form a block that reuses the x-y product and runs on one
+// thread.
+class StructureFactor
+{
+public:
+    // shell_width 0 means 2 pi / L, i.e. shells around integer |n|.
+    StructureFactor(double box_size, double k_max, double shell_width = 0.0);
+
+    void add_frame(const std::vector<std::array<double, 3>> &positions);
+    void add_frame(const MolecularSystem &system);
+
+    std::size_t frames() const;
+    std::size_t num_vectors() const;
+    // Non-empty shells by increasing k.
+    std::vector<SkShell> shells() const;
+
+private:
+    template <typename Position>
+    void accumulate(std::size_t n, Position position);
+
+    // All k-vectors with the same (nx, ny): nz and shell of each
+    struct Column
+    {
+        int nx, ny;
+        std::vector<int> nz, shell;
+    };
+
+    double box_size;
+    int n_max;
+    std::vector<Column> columns;
+    std::vector<double> shell_k;
+    std::vector<long> shell_count;
+    std::vector<double> shell_sum;
+    std::size_t n_frames = 0;
+    std::size_t n_vectors = 0;
+};
+
+#endif
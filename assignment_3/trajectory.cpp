@@ -0,0 +1,398 @@
+#include "trajectory.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+const char magic[8] = {'M', 'D', 'T', 'R', 'J', '0', '0', '1'};
+const char end_magic[8] = {'M', 'D', 'T', 'R', 'J', 'E', 'N', 'D'};
+const std::size_t header_bytes = 8 + 8 + 8 + 8 + 4 + 4;
+
+template <typename T>
+void put(std::vector<char> &buf, T value)
+{
+    const char *p = reinterpret_cast<const char *>(&value);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+T get(const char *p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+// Appends values of a fixed bit width, least significant bit first.
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<char> &buf) : buf(buf), acc(0), bits(0) {}
+
+    void write(std::uint32_t value, int width)
+    {
+        acc |= static_cast<std::uint64_t>(value) << bits;
+        bits += width;
+        while (bits >= 8)
+        {
+            buf.push_back(static_cast<char>(acc & 0xff));
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+
+    void flush()
+    {
+        if (bits > 0)
+            buf.push_back(static_cast<char>(acc & 0xff));
+        acc = 0;
+        bits = 0;
+    }
+
+private:
+    std::vector<char> &buf;
+    std::uint64_t acc;
+    int bits;
+};
+
+class BitReader
+{
+public:
+    BitReader(const char *p, const char *end) : p(p), end(end), acc(0), bits(0) {}
+
+    std::uint32_t read(int width)
+    {
+        while (bits < width)
+        {
+            const std::uint64_t byte = p < end ? static_cast<unsigned char>(*p++) : 0;
+            acc |= byte << bits;
+            bits += 8;
+        }
+        const std::uint32_t value = static_cast<std::uint32_t>(acc & ((std::uint64_t(1) << width) - 1));
+        acc >>= width;
+        bits -= width;
+        return value;
+    }
+
+private:
+    const char *p, *end;
+    std::uint64_t acc;
+    int bits;
+};
+
+// Periodic difference a - b on a grid of Q points, in [-Q/2, Q/2), zigzag coded.
+std::uint32_t encode_delta(std::uint32_t a, std::uint32_t b, std::uint32_t Q)
+{
+    std::int64_t d = static_cast<std::int64_t>(a) - b;
+    if (d < -static_cast<std::int64_t>(Q / 2))
+        d += Q;
+    else if (d >= static_cast<std::int64_t>((Q + 1) / 2))
+        d -= Q;
+    return static_cast<std::uint32_t>((d << 1) ^ (d >> 63));
+}
+
+std::uint32_t apply_delta(std::uint32_t b, std::uint32_t z, std::uint32_t Q)
+{
+    const std::int64_t d = static_cast<std::int64_t>(z >> 1) ^ -static_cast<std::int64_t>(z & 1);
+    std::int64_t a = b + d;
+    if (a < 0)
+        a += Q;
+    else if (a >= Q)
+        a -= Q;
+    return static_cast<std::uint32_t>(a);
+}
+
+int bit_width(std::uint32_t v)
+{
+    int w = 0;
+    while (v)
+    {
+        w++;
+        v >>= 1;
+    }
+    return w;
+}
+} // namespace
+
+TrajectoryWriter::TrajectoryWriter(const std::string &filename, double box_size, std::size_t num_atoms,
+                                   double precision, int key_interval, int block_atoms)
+    : out(filename, std::ios::binary), box_size(box_size), num_atoms(num_atoms),
+      key_interval(key_interval), block_atoms(block_atoms), previous(3 * num_atoms, 0),
+      position(0), closed(false)
+{
+    if (!out)
+        throw std::runtime_error("could not open " + filename + " for writing");
+    if (box_size <= 0.0 || precision <= 0.0 || box_size / precision > 2147483647.0)
+        throw std::invalid_argument("precision must be positive and at least box / 2^31");
+    if (key_interval < 1 || block_atoms < 1)
+        throw std::invalid_argument("key interval and block size must be positive");
+
+    grid = static_cast<std::uint32_t>(std::ceil(box_size / precision));
+    step = box_size / grid;
+
+    std::vector<char> header;
+    header.insert(header.end(), magic, magic + 8);
+    put<double>(header, box_size);
+    put<double>(header, precision);
+    put<std::uint64_t>(header, num_atoms);
+    put<std::uint32_t>(header, key_interval);
+    put<std::uint32_t>(header, block_atoms);
+    out.write(header.data(), header.size());
+    position = header.size();
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    if (!closed)
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+        }
+    }
+}
+
+std::size_t TrajectoryWriter::num_frames() const
+{
+    return offsets.size();
+}
+
+std::size_t TrajectoryWriter::bytes_written() const
+{
+    return position;
+}
+
+void TrajectoryWriter::write_frame(const std::vector<std::array<double, 3>> &positions)
+{
+    if (closed)
+        throw std::logic_error("trajectory already closed");
+    if (positions.size() != num_atoms)
+        throw std::invalid_argument("frame has the wrong number of atoms");
+
+    const bool key = offsets.size() % key_interval == 0;
+    const int n_blocks = static_cast<int>((num_atoms + block_atoms - 1) / block_atoms);
+    std::vector<std::vector<char>> blocks(n_blocks);
+
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < n_blocks; b++)
+    {
+        const std::size_t first = static_cast<std::size_t>(b) * block_atoms;
+        const std::size_t last = std::min(num_atoms, first + block_atoms);
+        std::vector<std::uint32_t> zig(3 * (last - first));
+        std::uint32_t max_zig[3] = {0, 0, 0};
+        for (std::size_t i = first; i < last; i++)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                double x = positions[i][d];
+                x -= box_size * std::floor(x / box_size);
+                std::uint32_t q = static_cast<std::uint32_t>(std::llround(x / step) % grid);
+                const std::uint32_t z = encode_delta(q, key ? 0 : previous[3 * i + d], grid);
+                previous[3 * i + d] = q;
+                zig[d * (last - first) + (i - first)] = z;
+                max_zig[d] = std::max(max_zig[d], z);
+            }
+        }
+
+        std::vector<char> &buf = blocks[b];
+        BitWriter bits(buf);
+        for (int d = 0; d < 3; d++)
+        {
+            const int width = bit_width(max_zig[d]);
+            buf.push_back(static_cast<char>(width));
+            if (width == 0)
+                continue;
+            for (std::size_t k = 0; k < last - first; k++)
+            {
+                bits.write(zig[d * (last - first) + k], width);
+            }
+            bits.flush();
+        }
+    }
+
+    std::vector<char> table;
+    put<std::uint32_t>(table, n_blocks);
+    for (const auto &buf : blocks)
+    {
+        put<std::uint32_t>(table, static_cast<std::uint32_t>(buf.size()));
+    }
+    offsets.push_back(position);
+    out.write(table.data(), table.size());
+    position += table.size();
+    for (const auto &buf : blocks)
+    {
+        out.write(buf.data(), buf.size());
+        position += buf.size();
+    }
+    if (!out)
+        throw std::runtime_error("write to trajectory failed");
+}
+
+void TrajectoryWriter::close()
+{
+    if (closed)
+        return;
+    closed = true;
+    std::vector<char> index;
+    for (std::uint64_t offset : offsets)
+    {
+        put<std::uint64_t>(index, offset);
+    }
+    put<std::uint64_t>(index, offsets.size());
+    put<std::uint64_t>(index, position);
+    index.insert(index.end(), end_magic, end_magic + 8);
+    out.write(index.data(), index.size());
+    position += index.size();
+    out.close();
+    if (!out)
+        throw std::runtime_error("write to trajectory failed");
+}
+
+TrajectoryReader::TrajectoryReader(const std::string &filename)
+    : in(filename, std::ios::binary), current_frame(0)
+{
+    if (!in)
+        throw std::runtime_error("could not open " + filename);
+
+    char header[header_bytes];
+    if (!in.read(header, header_bytes) || std::memcmp(header, magic, 8) != 0)
+        throw std::runtime_error(filename + " is not a trajectory file");
+    box = get<double>(header + 8);
+    const double precision = get<double>(header + 16);
+    atoms = get<std::uint64_t>(header + 24);
+    key_interval = static_cast<int>(get<std::uint32_t>(header + 32));
+    block_atoms = static_cast<int>(get<std::uint32_t>(header + 36));
+    grid = static_cast<std::uint32_t>(std::ceil(box / precision));
+    step = box / grid;
+
+    char trailer[24];
+    in.seekg(-24, std::ios::end);
+    if (!in.read(trailer, 24) || std::memcmp(trailer + 16, end_magic, 8) != 0)
+        throw std::runtime_error(filename + " has no frame index (truncated?)");
+    const std::uint64_t n_frames = get<std::uint64_t>(trailer);
+    const std::uint64_t index_offset = get<std::uint64_t>(trailer + 8);
+
+    std::vector<char> index(8 * n_frames);
+    in.seekg(index_offset);
+    if (!in.read(index.data(), index.size()))
+        throw std::runtime_error(filename + " has a corrupt frame index");
+    offsets.resize(n_frames + 1);
+    for (std::size_t k = 0; k < n_frames; k++)
+    {
+        offsets[k] = get<std::uint64_t>(index.data() + 8 * k);
+    }
+    offsets[n_frames] = index_offset;
+    current.assign(3 * atoms, 0);
+    current_frame = n_frames; // nothing decoded yet
+}
+
+std::size_t TrajectoryReader::num_frames() const
+{
+    return offsets.size() - 1;
+}
+
+std::size_t TrajectoryReader::num_atoms() const
+{
+    return atoms;
+}
+
+double TrajectoryReader::box_size() const
+{
+    return box;
+}
+
+double TrajectoryReader::precision() const
+{
+    return step;
+}
+
+std::vector<std::array<double, 3>> TrajectoryReader::read_frame(std::size_t k)
+{
+    if (k >= num_frames())
+        throw std::out_of_range("frame index out of range");
+
+    const std::size_t key = k - k % key_interval;
+    if (current_frame < num_frames() && current_frame < k && current_frame >= key)
+        decode(current_frame + 1, k, false);
+    else if (current_frame != k)
+        decode(key, k, true);
+    current_frame = k;
+
+    std::vector<std::array<double, 3>> positions(atoms);
+    const long n = static_cast<long>(atoms);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        positions[i] = {current[3 * i] * step, current[3 * i + 1] * step, current[3 * i + 2] * step};
+    }
+    return positions;
+}
+
+void TrajectoryReader::decode(std::size_t first, std::size_t last, bool from_key)
+{
+    std::vector<char> buf(offsets[last + 1] - offsets[first]);
+    in.clear();
+    in.seekg(offsets[first]);
+    if (!in.read(buf.data(), buf.size()))
+        throw std::runtime_error("trajectory read failed");
+
+    // Block start pointers of every frame in the range
+    const int n_blocks = static_cast<int>((atoms + block_atoms - 1) / block_atoms);
+    std::vector<const char *> block_begin((last - first + 1) * (n_blocks + 1));
+    for (std::size_t f = first; f <= last; f++)
+    {
+        const char *p = buf.data() + (offsets[f] - offsets[first]);
+        if (get<std::uint32_t>(p) != static_cast<std::uint32_t>(n_blocks))
+            throw std::runtime_error("corrupt trajectory frame");
+        const char *data = p + 4 + 4 * n_blocks;
+        const std::size_t row = (f - first) * (n_blocks + 1);
+        for (int b = 0; b < n_blocks; b++)
+        {
+            block_begin[row + b] = data;
+            data += get<std::uint32_t>(p + 4 + 4 * b);
+        }
+        block_begin[row + n_blocks] = data;
+    }
+
+    // Blocks are independent; each runs through the frames in order.
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < n_blocks; b++)
+    {
+        const std::size_t lo = static_cast<std::size_t>(b) * block_atoms;
+        const std::size_t hi = std::min(atoms, lo + block_atoms);
+        if (from_key)
+            std::fill(current.begin() + 3 * lo, current.begin() + 3 * hi, 0u);
+        for (std::size_t f = first; f <= last; f++)
+        {
+            const std::size_t row = (f - first) * (n_blocks + 1);
+            const char *p = block_begin[row + b];
+            const char *end = block_begin[row + b + 1];
+            for (int d = 0; d < 3; d++)
+            {
+                const int width = static_cast<unsigned char>(*p++);
+                const std::size_t bytes = (width * (hi - lo) + 7) / 8;
+                if (width > 0)
+                {
+                    BitReader bits(p, std::min(end, p + bytes));
+                    for (std::size_t i = lo; i < hi; i++)
+                    {
+                        current[3 * i + d] = apply_delta(current[3 * i + d], bits.read(width), grid);
+                    }
+                }
+                p += bytes;
+            }
+        }
+    }
+}
+
+bool is_trajectory_file(const std::string &filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    char head[8];
+    return in.read(head, 8) && std::memcmp(head, magic, 8) == 0;
+}
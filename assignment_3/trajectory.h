@@ -0,0 +1,88 @@
+// trajectory.h
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Compressed trajectory file (.trj).
+//
+// Positions are wrapped into the box and quantized to an integer grid of
+// Q = ceil(L / precision) steps per axis. Key frames store the grid
+// coordinates, every other frame the periodic difference to the previous
+// frame. Each frame is cut into blocks of block_atoms atoms; a block stores,
+// per axis, a bit width followed by its zigzag-coded values packed at that
+// width. Block b of a frame only depends on block b of the previous frame,
+// so blocks are encoded and decoded in parallel. A frame index at the end of
+// the file gives random access: frame k is rebuilt from the key frame at or
+// before it.
+//
+// Layout (little-endian):
+//   header  "MDTRJ001", box (f64), precision (f64), atoms (u64),
+//           key interval (u32), block atoms (u32)
+//   frame   n_blocks (u32), block sizes (u32 each), blocks
+//   index   frame offsets (u64 each), frame count (u64), index offset (u64),
+//           "MDTRJEND"
+class TrajectoryWriter
+{
+public:
+    TrajectoryWriter(const std::string &filename, double box_size, std::size_t num_atoms,
+                     double precision = 1e-3, int key_interval = 100, int block_atoms = 4096);
+    ~TrajectoryWriter();
+
+    // Positions outside the box are wrapped.
+    void write_frame(const std::vector<std::array<double, 3>> &positions);
+    // Writes the frame index; called by the destructor if needed.
+    void close();
+
+    std::size_t num_frames() const;
+    std::size_t bytes_written() const;
+
+private:
+    std::ofstream out;
+    double box_size, step;
+    std::uint32_t grid;
+    std::size_t num_atoms;
+    int key_interval, block_atoms;
+    std::vector<std::uint32_t> previous;
+    std::vector<std::uint64_t> offsets;
+    std::uint64_t position;
+    bool closed;
+};
+
+class TrajectoryReader
+{
+public:
+    explicit TrajectoryReader(const std::string &filename);
+
+    std::size_t num_frames() const;
+    std::size_t num_atoms() const;
+    double box_size() const;
+    double precision() const;
+
+    // Decodes frame k. Reading frames in order decodes each one once;
+    // jumping decodes forward from the nearest key frame.
+    std::vector<std::array<double, 3>> read_frame(std::size_t k);
+
+private:
+    void decode(std::size_t first, std::size_t last, bool from_key);
+
+    std::ifstream in;
+    double box, step;
+    std::uint32_t grid;
+    std::size_t atoms;
+    int key_interval, block_atoms;
+    std::vector<std::uint64_t> offsets;
+    // Grid coordinates of the last decoded frame (x, y, z interleaved).
+    std::vector<std::uint32_t> current;
+    std::size_t current_frame;
+};
+
+// True if the file starts with the trajectory magic.
+bool is_trajectory_file(const std::string &filename);
+
+#endif
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include "trajectory.h"
+
+using Frame = std::vector<std::array<double, 3>>;
+
+// All frames of a (possibly concatenated) text XYZ file.
+std::vector<Frame> readXYZFrames(const std::string &filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Could not open file: " << filename << "\n";
+        return {};
+    }
+    std::vector<Frame> frames;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::size_t numAtoms = 0;
+        std::istringstream header(line);
+        if (!(header >> numAtoms))
+            continue;
+        std::getline(file, line);
+        Frame data;
+        data.reserve(numAtoms);
+        std::string atom;
+        double x, y, z;
+        while (data.size() < numAtoms && std::getline(file, line))
+        {
+            std::istringstream iss(line);
+            if (iss >> atom >> x >> y >> z)
+                data.push_back({x, y, z});
+        }
+        if (data.size() != numAtoms)
+            std::cerr << "Warning: Expected " << numAtoms << " atoms, but read " << data.size() << "\n";
+        frames.push_back(std::move(data));
+    }
+    return frames;
+}
+
+int pack(double box_size, double precision, const std::string &out, char **inputs, int n_inputs)
+{
+    std::vector<Frame> frames;
+    std::uintmax_t text_bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < n_inputs; k++)
+    {
+        auto f = readXYZFrames(inputs[k]);
+        text_bytes += std::filesystem::file_size(inputs[k]);
+        frames.insert(frames.end(), std::make_move_iterator(f.begin()), std::make_move_iterator(f.end()));
+    }
+    std::chrono::duration<double, std::milli> parse = std::chrono::steady_clock::now() - start;
+    if (frames.empty())
+    {
+        std::cerr << "Error: no frames read.\n";
+        return 1;
+    }
+
+    TrajectoryWriter writer(out, box_size, frames[0].size(), precision);
+    for (const auto &f : frames)
+    {
+        writer.write_frame(f);
+    }
+    writer.close();
+
+    TrajectoryReader reader(out);
+    start = std::chrono::steady_clock::now();
+    double max_error = 0.0;
+    for (std::size_t k = 0; k < reader.num_frames(); k++)
+    {
+        const Frame f = reader.read_frame(k);
+        for (std::size_t i = 0; i < f.size(); i++)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                double e = std::abs(f[i][d] - frames[k][i][d]);
+                e -= box_size * std::floor(e / box_size + 0.5);
+                max_error = std::max(max_error, std::abs(e));
+            }
+        }
+    }
+    std::chrono::duration<double, std::milli> decode = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Frames: " << frames.size() << ", atoms: " << frames[0].size() << "\n"
+              << "Text: " << text_bytes << " bytes, parsed in " << parse.count() << " ms.\n"
+              << "Compressed: " << writer.bytes_written() << " bytes (ratio "
+              << static_cast<double>(text_bytes) / writer.bytes_written() << "), decoded and checked in "
+              << decode.count() << " ms.\n"
+              << "Max error: " << max_error << " (grid step " << reader.precision() << ")\n";
+    return 0;
+}
+
+int unpack(const std::string &in, std::size_t frame, const std::string &out)
+{
+    TrajectoryReader reader(in);
+    const Frame f = reader.read_frame(frame);
+    std::ofstream file(out);
+    file << f.size() << "\n\n";
+    for (const auto &p : f)
+    {
+        file << "C " << p[0] << " " << p[1] << " " << p[2] << "\n";
+    }
+    return file ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+    try
+    {
+        if (mode == "pack" && argc >= 6)
+            return pack(std::atof(argv[2]), std::atof(argv[3]), argv[4], argv + 5, argc - 5);
+        if (mode == "unpack" && argc == 5)
+            return unpack(argv[2], std::strtoull(argv[3], nullptr, 10), argv[4]);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "Usage: " << argv[0] << " pack <box_size> <precision> <out.trj> <in.xyz>...\n"
+              << "       " << argv[0] << " unpack <in.trj> <frame> <out.xyz>\n";
+    return 1;
+}
@@ -0,0 +1,177 @@
+#include "widom.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+WidomInserter::WidomInserter(const MolecularSystem &system)
+    : box_size(system.get_box_size()), grid(system.get_box_size(), 2.5)
+{
+    n_side = grid.cells_per_side();
+    grid.build(system.get_molecules());
+    const auto &pos = grid.positions();
+    const long n = static_cast<long>(pos.size());
+    xs.resize(n);
+    ys.resize(n);
+    zs.resize(n);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+    {
+        xs[i] = pos[i][0] - box_size * std::floor(pos[i][0] / box_size);
+        ys[i] = pos[i][1] - box_size * std::floor(pos[i][1] / box_size);
+        zs[i] = pos[i][2] - box_size * std::floor(pos[i][2] / box_size);
+    }
+}
+
+void WidomInserter::energies(const std::vector<std::array<double, 3>> &points, std::vector<double> &out) const
+{
+    const double rc2 = 2.5 * 2.5;
+    const double ic6 = 1.0 / (rc2 * rc2 * rc2);
+    const double u_cut = 4.0 * (ic6 * ic6 - ic6);
+    const long n_points = static_cast<long>(points.size());
+    out.resize(n_points);
+
+    // Masked shifted LJ of one point against particles [lo, hi)
+    auto block = [&](double px, double py, double pz, std::size_t lo, std::size_t hi)
+    {
+        double u = 0.0;
+#pragma omp simd reduction(+ : u)
+        for (std::size_t j = lo; j < hi; j++)
+        {
+            const double dx = px - xs[j], dy = py - ys[j], dz = pz - zs[j];
+            const double r2 = dx * dx + dy * dy + dz * dz;
+            const bool keep = (r2 < rc2) & (r2 >= 1e-12);
+            const double inv_r2 = 1.0 / (keep ? r2 : 1.0);
+            const double inv_r6 = inv_r2 * inv_r2 * inv_r2;
+            u += keep ? 4.0 * (inv_r6 * inv_r6 - inv_r6) - u_cut : 0.0;
+        }
+        return u;
+    };
+
+    if (n_side < 3)
+    {
+        // Too few cells for a 27-cell stencil without repeats; the box is
+        // at least 2 rc wide, so the nearest image of each particle is
+        // the only one in range. Try all 27 images, the mask drops the rest.
+        const std::size_t n = xs.size();
+#pragma omp parallel for schedule(static)
+        for (long p = 0; p < n_points; p++)
+        {
+            double u = 0.0;
+            for (int s = 0; s < 27; s++)
+            {
+                const double sx = (s % 3 - 1) * box_size, sy = (s / 3 % 3 - 1) * box_size, sz = (s / 9 - 1) * box_size;
+                const double px = points[p][0] - box_size * std::floor(points[p][0] / box_size) - sx;
+                const double py = points[p][1] - box_size * std::floor(points[p][1] / box_size) - sy;
+                const double pz = points[p][2] - box_size * std::floor(points[p][2] / box_size) - sz;
+                u += block(px, py, pz, 0, n);
+            }
+            out[p] = u;
+        }
+        return;
+    }
+
+    // Bin the points: counting sort by cell
+    const int n_cells = grid.num_cells();
+    std::vector<int> cell_of(n_points);
+#pragma omp parallel for schedule(static)
+    for (long p = 0; p < n_points; p++)
+    {
+        cell_of[p] = grid.cell_of(points[p]);
+    }
+    std::vector<std::size_t> start(n_cells + 1, 0), order(n_points);
+    for (long p = 0; p < n_points; p++)
+        start[cell_of[p] + 1]++;
+    for (int c = 0; c < n_cells; c++)
+        start[c + 1] += start[c];
+    {
+        std::vector<std::size_t> fill(start.begin(), start.end() - 1);
+        for (long p = 0; p < n_points; p++)
+            order[fill[cell_of[p]]++] = p;
+    }
+
+    const auto &cell_start = grid.cell_start();
+#pragma omp parallel for schedule(dynamic, 4)
+    for (int c = 0; c < n_cells; c++)
+    {
+        if (start[c] == start[c + 1])
+            continue;
+        const int cx = c % n_side, cy = (c / n_side) % n_side, cz = c / (n_side * n_side);
+        // Neighbour cells with the shift that brings them next to c
+        int nb[27];
+        double shift[27][3];
+        for (int k = 0; k < 27; k++)
+        {
+            const int o[3] = {k % 3 - 1, k / 3 % 3 - 1, k / 9 - 1};
+            const int t[3] = {cx + o[0], cy + o[1], cz + o[2]};
+            int w[3];
+            for (int d = 0; d < 3; d++)
+            {
+                w[d] = (t[d] + n_side) % n_side;
+                shift[k][d] = t[d] < 0 ? -box_size : (t[d] >= n_side ? box_size : 0.0);
+            }
+            nb[k] = w[0] + w[1] * n_side + w[2] * n_side * n_side;
+        }
+        for (std::size_t s = start[c]; s < start[c + 1]; s++)
+        {
+            const long p = static_cast<long>(order[s]);
+            double q[3];
+            for (int d = 0; d < 3; d++)
+                q[d] = points[p][d] - box_size * std::floor(points[p][d] / box_size);
+            double u = 0.0;
+            for (int k = 0; k < 27; k++)
+            {
+                u += block(q[0] - shift[k][0], q[1] - shift[k][1], q[2] - shift[k][2],
+                           cell_start[nb[k]], cell_start[nb[k] + 1]);
+            }
+            out[p] = u;
+        }
+    }
+}
+
+WidomResult WidomInserter::sample(std::size_t n, double temperature, unsigned long seed, std::size_t batch) const
+{
+    auto t0 = std::chrono::steady_clock::now();
+    // Global point p comes from stream p / chunk. Batches are whole chunks,
+    // so the points do not depend on the batch size either.
+    const std::size_t chunk = 4096;
+    batch = std::max(chunk, (batch + chunk - 1) / chunk * chunk);
+    std::vector<std::array<double, 3>> points;
+    std::vector<double> du;
+    double sum = 0.0;
+
+    for (std::size_t first = 0; first < n; first += batch)
+    {
+        const std::size_t m = std::min(batch, n - first);
+        points.resize(m);
+        const long n_chunks = static_cast<long>((m + chunk - 1) / chunk);
+#pragma omp parallel for schedule(static)
+        for (long k = 0; k < n_chunks; k++)
+        {
+            // seed_seq keeps 32 bits of each value
+            const std::uint64_t stream = first / chunk + k;
+            std::seed_seq seq{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(std::uint64_t(seed) >> 32),
+                              static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)};
+            std::mt19937_64 gen(seq);
+            std::uniform_real_distribution<double> uniform(0.0, box_size);
+            for (std::size_t p = k * chunk; p < std::min(m, (k + 1) * chunk); p++)
+                points[p] = {uniform(gen), uniform(gen), uniform(gen)};
+        }
+
+        energies(points, du);
+        const long mm = static_cast<long>(m);
+#pragma omp parallel for reduction(+ : sum) schedule(static)
+        for (long p = 0; p < mm; p++)
+        {
+            sum += std::exp(-du[p] / temperature);
+        }
+    }
+
+    WidomResult result;
+    result.insertions = n;
+    result.mean_boltzmann = n ? sum / n : 0.0;
+    result.mu_excess = -temperature * std::log(result.mean_boltzmann);
+    result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return result;
+}
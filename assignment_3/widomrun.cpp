@@ -0,0 +1,78 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "molecule.h"
+#include "molecularsystem.h"
+#include "widom.h"
+#include "numa.h"
+
+std::vector<std::array<double, 3>> readXYZPositions(double a, const std::string &filename);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5 || argc > 7)
+    {
+        std::cerr << "Usage: " << argv[0] << " <box_size> <positions_file> <temperature> <insertions> [<seed>] [--check]\n";
+        return 1;
+    }
+    const double box_size = std::atof(argv[1]);
+    const double temperature = std::atof(argv[3]);
+    const std::size_t insertions = std::strtoull(argv[4], nullptr, 10);
+    unsigned long seed = 1;
+    bool check = false;
+    for (int k = 5; k < argc; k++)
+    {
+        if (std::string(argv[k]) == "--check")
+            check = true;
+        else
+            seed = std::strtoul(argv[k], nullptr, 10);
+    }
+    if (box_size < 5.0 || temperature <= 0.0)
+    {
+        std::cerr << "Error: box_size must be at least 5 and the temperature positive.\n";
+        return 1;
+    }
+
+    pin_threads();
+    auto positions = readXYZPositions(box_size, argv[2]);
+    MolecularSystem system(box_size);
+    system.reserve(positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i)
+        system.add_molecule(Molecule(static_cast<int>(i), positions[i][0], positions[i][1], positions[i][2]));
+
+    auto start = std::chrono::steady_clock::now();
+    WidomInserter widom(system);
+    std::chrono::duration<double, std::milli> setup = std::chrono::steady_clock::now() - start;
+
+    if (check)
+    {
+        // A few insertions the slow way: copy, add, take the difference
+        const double E0 = system.total_potential_energy_LinkedCells();
+        std::vector<std::array<double, 3>> points = {{0.1, 0.2, 0.3}, {box_size / 2, box_size / 3, 1.0}, {box_size - 0.01, 0.5, box_size / 2}};
+        std::vector<double> du;
+        widom.energies(points, du);
+        double worst = 0.0;
+        for (std::size_t p = 0; p < points.size(); p++)
+        {
+            MolecularSystem copy = system;
+            copy.add_molecule(Molecule(-1, points[p][0], points[p][1], points[p][2]));
+            const double ref = copy.total_potential_energy_LinkedCells() - E0;
+            worst = std::max(worst, std::abs(ref - du[p]) / std::max(1.0, std::abs(ref)));
+            std::cout << "dU = " << du[p] << " (reference " << ref << ")\n";
+        }
+        std::cout << "Largest relative deviation: " << worst << "\n";
+    }
+
+    WidomResult r = widom.sample(insertions, temperature, seed);
+    std::cout << "N = " << positions.size() << ", T = " << temperature << ", " << r.insertions
+              << " insertions in " << r.ms << " ms (setup " << setup.count() << " ms, "
+              << r.insertions / (r.ms / 1000.0) << " insertions/s)\n"
+              << "<exp(-dU/T)> = " << r.mean_boltzmann << ", mu_ex = " << r.mu_excess << "\n";
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "workpool.h"
+#include "numa.h"
+#include <omp.h>
+
+// Worker index of the calling thread, -1 outside the pool
+static thread_local int worker_id = -1;
+static thread_local const WorkStealingPool *worker_pool = nullptr;
+
+WorkStealingPool::WorkStealingPool(int num_workers)
+{
+    for (int w = 0; w < num_workers; w++)
+        queues.push_back(std::make_unique<Queue>());
+    for (int w = 0; w < num_workers; w++)
+        threads.emplace_back(&WorkStealingPool::worker, this, w);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : threads)
+        t.join();
+}
+
+int WorkStealingPool::num_workers() const
+{
+    return static_cast<int>(queues.size());
+}
+
+long WorkStealingPool::steals() const
+{
+    return stolen.load();
+}
+
+void WorkStealingPool::submit(std::function<void()> task)
+{
+    const int n = num_workers();
+    const int target = worker_pool == this ? worker_id : static_cast<int>(next++ % n);
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        // Under the sleep mutex so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued++;
+    }
+    wake.notify_one();
+}
+
+bool WorkStealingPool::try_pop(int id, std::function<void()> &task)
+{
+    const int n = num_workers();
+    {
+        Queue &own = *queues[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (int k = 1; k < n; k++)
+    {
+        Queue &victim = *queues[(id + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::worker(int id)
+{
+    worker_id = id;
+    worker_pool = this;
+    pin_worker(id);
+    omp_set_num_threads(1);
+
+    std::function<void()> task;
+    while (true)
+    {
+        if (try_pop(id, task))
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                queued--;
+            }
+            task();
+            task = nullptr;
+            if (--pending == 0)
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this]
+                  { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+            return;
+    }
+}
+
+void WorkStealingPool::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    idle.wait(lock, [this]
+              { return pending == 0; });
+}
@@ -0,0 +1,59 @@
+// workpool.h
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, one per CPU, each with its own task deque.
+// A worker runs its newest task first (the follow-up it just submitted is
+// still in cache) and, when its deque is empty, steals the oldest task of
+// another worker. Workers are pinned like the OpenMP team and run with one
+// OpenMP thread each, so OpenMP loops inside tasks do not oversubscribe.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int num_workers);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    // From a worker: onto its own deque. From outside: round robin.
+    void submit(std::function<void()> task);
+    // Blocks until every submitted task, including ones submitted by
+    // tasks, has finished.
+    void wait_idle();
+
+    int num_workers() const;
+    // Tasks that ran on a different worker than they were queued on.
+    long steals() const;
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void worker(int id);
+    bool try_pop(int id, std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleep_mutex;
+    std::condition_variable wake, idle;
+    std::atomic<long> pending{0};
+    std::atomic<long> queued{0};
+    std::atomic<long> stolen{0};
+    std::atomic<unsigned> next{0};
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include "advection.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " <centered|lax-friedrichs|upwind> <nx> <nt> [<t_end>] [--check] [--out <file>]\n";
+        return 1;
+    }
+    const std::string scheme = argv[1];
+    const int nx = std::atoi(argv[2]);
+    const long nt = std::atol(argv[3]);
+    double t_end = 1.2;
+    bool check = false;
+    std::string out_file;
+    for (int i = 4; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--check")
+            check = true;
+        else if (arg == "--out" && i + 1 < argc)
+            out_file = argv[++i];
+        else
+            t_end = std::atof(argv[i]);
+    }
+    if (nx < 1 || nt < 0)
+    {
+        std::cerr << "Error: nx must be positive and nt non-negative.\n";
+        return 1;
+    }
+
+    // Same setup as solve_pde in exercise_2_2.py
+    const double dx = 1.0 / nx;
+    const double dt = nt > 0 ? t_end / nt : 0.0;
+    const double lambda = dt / dx;
+    Stencil3 s;
+    if (scheme == "centered")
+        s = centered_stencil(lambda);
+    else if (scheme == "lax-friedrichs")
+        s = lax_friedrichs_stencil(lambda);
+    else if (scheme == "upwind")
+        s = upwind_stencil(lambda);
+    else
+    {
+        std::cerr << "Unknown scheme: " << scheme << "\n";
+        return 1;
+    }
+
+    std::vector<double> u0(nx);
+    for (int j = 0; j < nx; j++)
+        u0[j] = std::sin(2 * M_PI * j * dx);
+
+    AdvectionSolver solver(u0, s);
+    auto start = std::chrono::steady_clock::now();
+    solver.run(nt);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    const std::vector<double> u = solver.solution();
+
+    std::cout << scheme << ": " << nx << " cells, " << nt << " steps (dt/dx = " << lambda << ") in "
+              << elapsed.count() * 1e3 << " ms ("
+              << nt * double(nx) / elapsed.count() / 1e6 << " Mcell-updates/s)\n";
+
+    if (check)
+    {
+        std::vector<double> ref = u0, next;
+        for (long t = 0; t < nt; t++)
+        {
+            reference_step(ref, next, s);
+            ref.swap(next);
+        }
+        double max_diff = 0.0;
+        for (int j = 0; j < nx; j++)
+            max_diff = std::max(max_diff, std::fabs(u[j] - ref[j]));
+        std::cout << "Max difference from reference loop: " << max_diff << "\n";
+    }
+
+    if (!out_file.empty())
+    {
+        std::ofstream out(out_file);
+        for (int j = 0; j < nx; j++)
+            out << j * dx << " " << u[j] << "\n";
+    }
+    return 0;
+}
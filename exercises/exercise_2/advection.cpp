@@ -0,0 +1,99 @@
+#include "advection.h"
+#include <algorithm>
+#include <utility>
+
+Stencil3 centered_stencil(double lambda)
+{
+    return {0.5 * lambda, 1.0, -0.5 * lambda};
+}
+
+Stencil3 lax_friedrichs_stencil(double lambda)
+{
+    return {0.5 + 0.5 * lambda, 0.0, 0.5 - 0.5 * lambda};
+}
+
+Stencil3 upwind_stencil(double lambda)
+{
+    return {lambda, 1.0 - lambda, 0.0};
+}
+
+void reference_step(const std::vector<double> &u, std::vector<double> &un, Stencil3 s)
+{
+    const int nx = static_cast<int>(u.size());
+    un.resize(nx);
+    for (int j = 0; j < nx; j++)
+    {
+        const int jm = (j - 1 + nx) % nx;
+        const int jp = (j + 1) % nx;
+        un[j] = s.left * u[jm] + s.center * u[j] + s.right * u[jp];
+    }
+}
+
+AdvectionSolver::AdvectionSolver(const std::vector<double> &u0, Stencil3 s,
+                                 int block_size, int fused_steps)
+    : m_s(s), m_n(static_cast<int>(u0.size())),
+      m_block(std::max(1, block_size)), m_fused(std::max(1, fused_steps))
+{
+    // The halo is copied from the periodic images, so it cannot be wider
+    // than the domain itself
+    m_fused = std::min(m_fused, m_n);
+    m_u.assign(m_n + 2 * m_fused, 0.0);
+    m_next.assign(m_n + 2 * m_fused, 0.0);
+    std::copy(u0.begin(), u0.end(), m_u.begin() + m_fused);
+}
+
+void AdvectionSolver::run(long steps)
+{
+    while (steps > 0)
+    {
+        const int k = static_cast<int>(std::min<long>(steps, m_fused));
+        pass(k);
+        steps -= k;
+    }
+}
+
+std::vector<double> AdvectionSolver::solution() const
+{
+    return std::vector<double>(m_u.begin() + m_fused, m_u.begin() + m_fused + m_n);
+}
+
+void AdvectionSolver::pass(int steps)
+{
+    const int n = m_n, h = m_fused;
+    const double a = m_s.left, b = m_s.center, c = m_s.right;
+
+    // Refresh the periodic ghost cells
+    double *u = m_u.data();
+    std::copy(u + n, u + n + h, u);
+    std::copy(u + h, u + 2 * h, u + n + h);
+
+    const int num_blocks = (n + m_block - 1) / m_block;
+#pragma omp parallel
+    {
+        std::vector<double> buf_a(m_block + 2 * h), buf_b(m_block + 2 * h);
+#pragma omp for schedule(static)
+        for (int blk = 0; blk < num_blocks; blk++)
+        {
+            const int begin = blk * m_block;
+            const int len = std::min(m_block, n - begin);
+
+            // Block plus halo; global ghost index begin maps to cell begin - h
+            double *src = buf_a.data(), *dst = buf_b.data();
+            std::copy(u + begin, u + begin + len + 2 * h, src);
+
+            // Each step the valid region shrinks by one cell per side
+            for (int t = 0; t < steps; t++)
+            {
+                const int lo = t + 1, hi = len + 2 * h - t - 1;
+#pragma omp simd
+                for (int j = lo; j < hi; j++)
+                {
+                    dst[j] = a * src[j - 1] + b * src[j] + c * src[j + 1];
+                }
+                std::swap(src, dst);
+            }
+            std::copy(src + h, src + h + len, m_next.data() + h + begin);
+        }
+    }
+    std::swap(m_u, m_next);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+// Linear advection u_t + u_x = 0 on a periodic grid with the three-point
+// schemes of exercise_2_2.py. With lambda = dt / dx every scheme is
+//   un[j] = left * u[j-1] + center * u[j] + right * u[j+1].
+struct Stencil3
+{
+    double left, center, right;
+};
+
+Stencil3 centered_stencil(double lambda);
+Stencil3 lax_friedrichs_stencil(double lambda);
+Stencil3 upwind_stencil(double lambda);
+
+// Straightforward one-step update with modulo indexing, for validation
+void reference_step(const std::vector<double> &u, std::vector<double> &un, Stencil3 s);
+
+// Temporally blocked solver. The domain is cut into blocks of block_size
+// cells; each block is loaded once with a halo of fused_steps cells on both
+// sides and advanced fused_steps steps inside two cache-resident buffers
+// before it is written back. Halos overlap, so blocks run in parallel
+// without synchronisation. Periodicity is handled by ghost cells that are
+// refreshed once per pass, never by modulo in the inner loop.
+class AdvectionSolver
+{
+public:
+    AdvectionSolver(const std::vector<double> &u0, Stencil3 s,
+                    int block_size = 4096, int fused_steps = 16);
+
+    void run(long steps);
+    std::vector<double> solution() const;
+
+private:
+    void pass(int steps);
+
+    Stencil3 m_s;
+    int m_n, m_block, m_fused;
+    // Global state with m_fused ghost cells on each side, double buffered
+    std::vector<double> m_u, m_next;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+// First-order finite-volume solver for the 2D Euler equations with the HLL
+// Riemann solver; the C++ counterpart of HLL.py and 2d.py.
+//
+// The conserved fields (rho, rho*u, rho*v, E) are stored as four separate
+// arrays (SoA) of (nx + 2) x (ny + 2) cells with one ghost layer, y fastest,
+// so both sweeps read contiguous runs along j.
+
+const double gamma_gas = 1.4;
+
+enum class Boundary
+{
+    Reflective,  // solid walls, as in 2d.py
+    Transmissive // zero-gradient outflow, as in HLL.py
+};
+
+class EulerGrid
+{
+public:
+    EulerGrid(int nx, int ny, double lx, double ly, Boundary bc);
+
+    int nx() const { return m_nx; }
+    int ny() const { return m_ny; }
+    double dx() const { return m_dx; }
+    double dy() const { return m_dy; }
+
+    // Interior cells are 1..nx, 1..ny
+    std::size_t idx(int i, int j) const { return static_cast<std::size_t>(i) * (m_ny + 2) + j; }
+
+    void set_primitive(int i, int j, double rho, double u, double v, double p);
+    std::array<double, 4> primitive(int i, int j) const; // rho, u, v, p
+
+    void apply_boundary();
+
+    // CFL * min(dx, dy) / max(|u| + |v| + a), reduced over all cells in parallel
+    double stable_dt(double cfl) const;
+
+    // One unsplit forward-Euler step; ghost cells must be current
+    void step(double dt);
+
+    // Step to t_final; returns the number of steps taken
+    long advance(double t_final, double cfl);
+
+private:
+    int m_nx, m_ny;
+    double m_dx, m_dy;
+    Boundary m_bc;
+    std::array<std::vector<double>, 4> m_U, m_next;
+};
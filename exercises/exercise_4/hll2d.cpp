@@ -0,0 +1,162 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include "euler2d.h"
+
+// Exact density of the Sod shock tube (Toro, ch. 4) at x for time t,
+// used to validate the solver
+static double sod_exact_density(double x, double t)
+{
+    const double g = gamma_gas;
+    const double rL = 1.0, uL = 0.0, pL = 1.0;
+    const double rR = 0.125, uR = 0.0, pR = 0.1;
+    const double aL = std::sqrt(g * pL / rL), aR = std::sqrt(g * pR / rR);
+
+    auto f = [&](double p, double rK, double pK, double aK, double &df)
+    {
+        if (p > pK)
+        {
+            const double A = 2.0 / ((g + 1) * rK), B = (g - 1) / (g + 1) * pK;
+            const double q = std::sqrt(A / (p + B));
+            df = q * (1 - (p - pK) / (2 * (B + p)));
+            return (p - pK) * q;
+        }
+        df = std::pow(p / pK, -(g + 1) / (2 * g)) / (rK * aK);
+        return 2 * aK / (g - 1) * (std::pow(p / pK, (g - 1) / (2 * g)) - 1);
+    };
+
+    // Newton iteration for the star pressure
+    double p = 0.5 * (pL + pR);
+    for (int it = 0; it < 50; it++)
+    {
+        double dfL, dfR;
+        const double F = f(p, rL, pL, aL, dfL) + f(p, rR, pR, aR, dfR) + (uR - uL);
+        const double p_new = std::max(1e-12, p - F / (dfL + dfR));
+        if (std::fabs(p_new - p) < 1e-14 * p)
+            break;
+        p = p_new;
+    }
+    double dfL, dfR;
+    const double u_star = 0.5 * (uL + uR) + 0.5 * (f(p, rR, pR, aR, dfR) - f(p, rL, pL, aL, dfL));
+
+    // Sample the self-similar solution at S = x / t (left rarefaction, right shock)
+    const double S = (x - 0.5) / t;
+    if (S <= u_star)
+    {
+        const double a_star = aL * std::pow(p / pL, (g - 1) / (2 * g));
+        if (S <= uL - aL)
+            return rL;
+        if (S > u_star - a_star)
+            return rL * std::pow(p / pL, 1 / g);
+        const double c = 2 / (g + 1) * (aL + (g - 1) / 2 * (uL - S));
+        return rL * std::pow(c / aL, 2 / (g - 1));
+    }
+    const double shock = uR + aR * std::sqrt((g + 1) / (2 * g) * p / pR + (g - 1) / (2 * g));
+    if (S >= shock)
+        return rR;
+    const double k = (g - 1) / (g + 1);
+    return rR * (p / pR + k) / (k * p / pR + 1);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sod|sod1d|riemann2d> [<nx> <ny>] [<out.dat>]\n";
+        return 1;
+    }
+    const std::string problem = argv[1];
+
+    // Defaults follow 2d.py (sod) and HLL.py (sod1d)
+    int nx = 400, ny = 80;
+    double ly = 0.2, tf = 0.25, cfl = 0.6;
+    Boundary bc = Boundary::Reflective;
+    if (problem == "sod1d")
+    {
+        nx = 500, ny = 1, tf = 0.2, cfl = 0.8;
+        bc = Boundary::Transmissive;
+    }
+    else if (problem == "riemann2d")
+    {
+        nx = 400, ny = 400, ly = 1.0, tf = 0.3, cfl = 0.6;
+        bc = Boundary::Transmissive;
+    }
+    else if (problem != "sod")
+    {
+        std::cerr << "Unknown problem: " << problem << "\n";
+        return 1;
+    }
+    if (argc >= 4)
+    {
+        nx = std::atoi(argv[2]);
+        ny = std::atoi(argv[3]);
+        if (nx < 1 || ny < 1)
+        {
+            std::cerr << "Error: nx and ny must be positive.\n";
+            return 1;
+        }
+    }
+    const std::string out_file = argc == 3 ? argv[2] : (argc >= 5 ? argv[4] : "");
+
+    EulerGrid grid(nx, ny, 1.0, ly, bc);
+    for (int i = 1; i <= nx; i++)
+    {
+        const double x = (i - 0.5) * grid.dx();
+        for (int j = 1; j <= ny; j++)
+        {
+            const double y = (j - 0.5) * grid.dy();
+            if (problem == "riemann2d")
+            {
+                // Four-shock configuration (Lax & Liu, configuration 3)
+                if (x >= 0.5 && y >= 0.5)
+                    grid.set_primitive(i, j, 1.5, 0.0, 0.0, 1.5);
+                else if (x < 0.5 && y >= 0.5)
+                    grid.set_primitive(i, j, 0.5323, 1.206, 0.0, 0.3);
+                else if (x < 0.5)
+                    grid.set_primitive(i, j, 0.138, 1.206, 1.206, 0.029);
+                else
+                    grid.set_primitive(i, j, 0.5323, 0.0, 1.206, 0.3);
+            }
+            else if (x < 0.5)
+                grid.set_primitive(i, j, 1.0, 0.0, 0.0, 1.0);
+            else
+                grid.set_primitive(i, j, 0.125, 0.0, 0.0, 0.1);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long steps = grid.advance(tf, cfl);
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+
+    std::cout << "Problem " << problem << ", " << nx << " x " << ny << " cells, t = " << tf
+              << ": " << steps << " steps in " << elapsed.count() * 1e3 << " ms ("
+              << steps * double(nx) * ny / elapsed.count() / 1e6 << " Mcell-updates/s)\n";
+
+    if (problem != "riemann2d")
+    {
+        // Every row is the same 1D problem; check the middle one
+        double l1 = 0.0;
+        const int j = (ny + 1) / 2;
+        for (int i = 1; i <= nx; i++)
+            l1 += std::fabs(grid.primitive(i, j)[0] - sod_exact_density((i - 0.5) * grid.dx(), tf)) * grid.dx();
+        std::cout << "L1 density error vs exact Sod solution: " << l1 << "\n";
+    }
+
+    if (!out_file.empty())
+    {
+        std::ofstream out(out_file);
+        out << "# x y rho u v p\n";
+        for (int i = 1; i <= nx; i++)
+            for (int j = 1; j <= ny; j++)
+            {
+                auto w = grid.primitive(i, j);
+                out << (i - 0.5) * grid.dx() << " " << (j - 0.5) * grid.dy() << " "
+                    << w[0] << " " << w[1] << " " << w[2] << " " << w[3] << "\n";
+            }
+    }
+    return 0;
+}